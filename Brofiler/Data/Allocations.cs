@@ -0,0 +1,95 @@
+﻿using System;
+using System.Collections.Generic;
+using System.IO;
+using System.Linq;
+
+namespace Profiler.Data
+{
+    // Allocations made inside of a single scope during a frame
+    public class AllocationStat
+    {
+        // Index in EventDescriptionBoard, -1 - outside of instrumented scopes
+        public int DescriptionIndex { get; set; }
+        public EventDescription Description { get; set; }
+
+        public ulong AllocatedBytes { get; set; }
+        public uint AllocationCount { get; set; }
+
+        // Max bytes allocated in the scope and not freed yet at any moment of the frame
+        public ulong PeakLiveBytes { get; set; }
+
+        public static AllocationStat Read(BinaryReader reader, EventDescriptionBoard board)
+        {
+            AllocationStat stat = new AllocationStat();
+            stat.DescriptionIndex = reader.ReadInt32();
+            stat.AllocatedBytes = reader.ReadUInt64();
+            stat.AllocationCount = reader.ReadUInt32();
+            stat.PeakLiveBytes = reader.ReadUInt64();
+
+            if (stat.DescriptionIndex >= 0 && stat.DescriptionIndex < board.Board.Count)
+                stat.Description = board[stat.DescriptionIndex];
+
+            return stat;
+        }
+    }
+
+    public class AllocationFrame : Durable
+    {
+        public List<AllocationStat> Stats { get; set; }
+
+        public static AllocationFrame Read(BinaryReader reader, EventDescriptionBoard board)
+        {
+            AllocationFrame frame = new AllocationFrame();
+            frame.ReadDurable(reader);
+
+            int count = reader.ReadInt32();
+            frame.Stats = new List<AllocationStat>(count);
+
+            for (int i = 0; i < count; ++i)
+                frame.Stats.Add(AllocationStat.Read(reader, board));
+
+            return frame;
+        }
+    }
+
+    public class AllocationBoard : IResponseHolder
+    {
+        public override DataResponse Response { get; set; }
+        public FrameGroup Group { get; set; }
+
+        public List<AllocationFrame> Frames { get; set; }
+
+        // Scopes which churn the most memory over the whole capture go first
+        public IEnumerable<AllocationStat> HotScopes
+        {
+            get
+            {
+                return Frames.SelectMany(frame => frame.Stats)
+                             .GroupBy(stat => stat.DescriptionIndex)
+                             .Select(group => new AllocationStat()
+                             {
+                                 DescriptionIndex = group.Key,
+                                 Description = group.First().Description,
+                                 AllocatedBytes = group.Aggregate(0UL, (sum, stat) => sum + stat.AllocatedBytes),
+                                 AllocationCount = group.Aggregate(0U, (sum, stat) => sum + stat.AllocationCount),
+                                 PeakLiveBytes = group.Max(stat => stat.PeakLiveBytes),
+                             })
+                             .OrderByDescending(stat => stat.AllocatedBytes);
+            }
+        }
+
+        public AllocationBoard(DataResponse response, FrameGroup group)
+        {
+            Group = group;
+            Response = response;
+
+            BinaryReader reader = response.Reader;
+
+            int count = reader.ReadInt32();
+            Frames = new List<AllocationFrame>(count);
+
+            for (int i = 0; i < count; ++i)
+                Frames.Add(AllocationFrame.Read(reader, group.Board));
+        }
+    }
+}
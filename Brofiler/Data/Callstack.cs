@@ -1,17 +1,48 @@
 ﻿using System;
 using System.Collections.Generic;
+using System.IO;
 using System.Linq;
 using System.Text;
 using System.Threading.Tasks;
 
 namespace Profiler.Data
 {
+	public class SysCall : Durable
+	{
+		public UInt64 Id { get; set; }
+
+		// The exit of the call was not captured
+		public bool IsOpen { get { return Finish == 0; } }
+	}
+
+	public class SysCallStat
+	{
+		public int ThreadIndex { get; set; }
+		public UInt64 Id { get; set; }
+		public uint Count { get; set; }
+
+		// Ticks, calls without exit are not included
+		public long Time { get; set; }
+	}
+
+	public class SysCallFrameStats : Durable
+	{
+		public List<SysCallStat> Stats { get; set; }
+	}
+
 	public class SysCallBoard : IResponseHolder
 	{
 		public override DataResponse Response { get; set; }
 
+		// Syscall enter timestamp => syscall id, used to tag callstacks
 		Dictionary<UInt64, UInt64> systemCalls;
 
+		// NETWORK_PROTOCOL_VERSION_14: Thread index => calls
+		public Dictionary<int, List<SysCall>> ThreadCalls { get; private set; }
+
+		// NETWORK_PROTOCOL_VERSION_14: per main thread frame {ThreadIndex, Id} => {Count, Time}
+		public List<SysCallFrameStats> Frames { get; private set; }
+
 		public Tuple<bool, UInt64> GetSystemCallParams(UInt64 timeStamp)
 		{
 			UInt64 sysCallId = 0;
@@ -24,9 +55,64 @@ namespace Profiler.Data
 			return new Tuple<bool, UInt64>(isSystemCall, sysCallId);
 		}
 
+		// {ThreadCount, {ThreadIndex, CallCount, {Start, Finish, Id}[]}[], FrameCount, {Start, Finish, StatCount, {ThreadIndex, Id, Count, Time}[]}[]}
+		static void ReadPerThread(SysCallBoard result, BinaryReader reader)
+		{
+			int threadCount = reader.ReadInt32();
+			for (int i = 0; i < threadCount; ++i)
+			{
+				int threadIndex = reader.ReadInt32();
+				int callCount = reader.ReadInt32();
+
+				List<SysCall> calls = new List<SysCall>(callCount);
+				for (int j = 0; j < callCount; ++j)
+				{
+					SysCall call = new SysCall();
+					call.ReadDurable(reader);
+					call.Id = reader.ReadUInt64();
+					calls.Add(call);
+
+					if (!result.systemCalls.ContainsKey((UInt64)call.Start))
+					{
+						result.systemCalls.Add((UInt64)call.Start, call.Id);
+					}
+				}
+
+				result.ThreadCalls[threadIndex] = calls;
+			}
+
+			int frameCount = reader.ReadInt32();
+			for (int i = 0; i < frameCount; ++i)
+			{
+				SysCallFrameStats frame = new SysCallFrameStats();
+				frame.ReadDurable(reader);
+
+				int statCount = reader.ReadInt32();
+				frame.Stats = new List<SysCallStat>(statCount);
+
+				for (int j = 0; j < statCount; ++j)
+				{
+					SysCallStat stat = new SysCallStat();
+					stat.ThreadIndex = reader.ReadInt32();
+					stat.Id = reader.ReadUInt64();
+					stat.Count = reader.ReadUInt32();
+					stat.Time = reader.ReadInt64();
+					frame.Stats.Add(stat);
+				}
+
+				result.Frames.Add(frame);
+			}
+		}
+
 		public static SysCallBoard Create(DataResponse response, FrameGroup group)
 		{
-			SysCallBoard result = new SysCallBoard() { Response = response, systemCalls = new Dictionary<UInt64, UInt64>() };
+			SysCallBoard result = new SysCallBoard() { Response = response, systemCalls = new Dictionary<UInt64, UInt64>(), ThreadCalls = new Dictionary<int, List<SysCall>>(), Frames = new List<SysCallFrameStats>() };
+
+			if (response.Version >= NetworkProtocol.NETWORK_PROTOCOL_VERSION_14)
+			{
+				ReadPerThread(result, response.Reader);
+				return result;
+			}
 
 			ulong totalCount = response.Reader.ReadUInt32();
 			for (ulong i = 0; i < totalCount; i += 2)
@@ -57,10 +143,85 @@ namespace Profiler.Data
 		public Dictionary<UInt64, List<Callstack>> CallstackMap { get; set; }
 		public override DataResponse Response { get; set; }
 
+		static Callstack CreateCallstack(UInt64 timestamp, SysCallBoard sysCallBoard)
+		{
+			Callstack callstack = new Callstack() { Start = (long)timestamp, Reason = CallStackReason.AutoSample };
+
+			if (sysCallBoard != null)
+			{
+				Tuple<bool, UInt64> sysCallDesc = sysCallBoard.GetSystemCallParams(timestamp);
+
+				if (sysCallDesc.Item1)
+				{
+					if (sysCallDesc.Item2 < (int)CallStackReason.MaxReasonsCount)
+					{
+						callstack.Reason = (CallStackReason)sysCallDesc.Item2;
+					}
+					else
+					{
+						callstack.Reason = CallStackReason.SysCall;
+					}
+				}
+			}
+
+			return callstack;
+		}
+
+		void AddCallstack(UInt64 threadID, Callstack callstack)
+		{
+			List<Callstack> callstacks;
+			if (!CallstackMap.TryGetValue(threadID, out callstacks))
+			{
+				callstacks = new List<Callstack>();
+				CallstackMap.Add(threadID, callstacks);
+			}
+
+			callstacks.Add(callstack);
+		}
+
+		// NETWORK_PROTOCOL_VERSION_13: {StackCount, {Count, Addresses[Count]}[StackCount], SampleCount, {ThreadID, Timestamp, StackID}[SampleCount]}
+		static void ReadDeduplicated(CallstackPack result, DataResponse response, ISamplingBoard board, SysCallBoard sysCallBoard)
+		{
+			uint stackCount = response.Reader.ReadUInt32();
+
+			List<SamplingDescription[]> stacks = new List<SamplingDescription[]>((int)stackCount);
+			for (uint i = 0; i < stackCount; ++i)
+			{
+				UInt64 count = response.Reader.ReadUInt64();
+
+				SamplingDescription[] stack = new SamplingDescription[count];
+				for (ulong addressIndex = 0; addressIndex < count; ++addressIndex)
+				{
+					// Stored outermost frame first, Callstack keeps the innermost one first
+					stack[count - addressIndex - 1] = board.GetDescription(response.Reader.ReadUInt64());
+				}
+
+				stacks.Add(stack);
+			}
+
+			uint sampleCount = response.Reader.ReadUInt32();
+			for (uint i = 0; i < sampleCount; ++i)
+			{
+				UInt64 threadID = response.Reader.ReadUInt64();
+				UInt64 timestamp = response.Reader.ReadUInt64();
+				UInt32 stackID = response.Reader.ReadUInt32();
+
+				Callstack callstack = CreateCallstack(timestamp, sysCallBoard);
+				callstack.AddRange(stacks[(int)stackID]);
+				result.AddCallstack(threadID, callstack);
+			}
+		}
+
 		public static CallstackPack Create(DataResponse response, ISamplingBoard board, SysCallBoard sysCallBoard)
         {
 			CallstackPack result = new CallstackPack() { Response = response, CallstackMap = new Dictionary<ulong, List<Callstack>>() };
 
+			if (response.Version >= NetworkProtocol.NETWORK_PROTOCOL_VERSION_13)
+			{
+				ReadDeduplicated(result, response, board, sysCallBoard);
+				return result;
+			}
+
             ulong totalCount = response.Reader.ReadUInt32();
 
 			for (ulong i = 0; i < totalCount; )
@@ -70,24 +231,7 @@ namespace Profiler.Data
 
 				UInt64 count = response.Reader.ReadUInt64();
 
-				Callstack callstack = new Callstack() { Start = (long)timestamp, Reason = CallStackReason.AutoSample };
-
-				if (sysCallBoard != null)
-				{
-					Tuple<bool, UInt64> sysCallDesc = sysCallBoard.GetSystemCallParams(timestamp);
-
-					if (sysCallDesc.Item1)
-					{
-						if (sysCallDesc.Item2 < (int)CallStackReason.MaxReasonsCount)
-						{
-							callstack.Reason = (CallStackReason)sysCallDesc.Item2;
-						}
-						else
-						{
-							callstack.Reason = CallStackReason.SysCall;
-						}
-					}
-				}
+				Callstack callstack = CreateCallstack(timestamp, sysCallBoard);
 
                 for (ulong addressIndex = 0; addressIndex < count; ++addressIndex)
                 {
@@ -96,15 +240,8 @@ namespace Profiler.Data
 					callstack.Add(desc);
                 }
 
-				List<Callstack> callstacks;
-				if (!result.CallstackMap.TryGetValue(threadID, out callstacks))
-				{
-					callstacks = new List<Callstack>();
-					result.CallstackMap.Add(threadID, callstacks);
-				}
-
                 callstack.Reverse();
-                callstacks.Add(callstack);
+				result.AddCallstack(threadID, callstack);
 
 				i += (3 + count);
             }
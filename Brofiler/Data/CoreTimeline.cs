@@ -0,0 +1,124 @@
+﻿using System;
+using System.Collections.Generic;
+using System.IO;
+
+namespace Profiler.Data
+{
+    public class CoreInterval : Durable
+    {
+        // Index in EventDescriptionBoard.Threads, -1 - thread of another process
+        public int ThreadIndex { get; set; }
+
+        public bool IsOtherProcess { get { return ThreadIndex < 0; } }
+
+        public static CoreInterval Read(BinaryReader reader)
+        {
+            CoreInterval interval = new CoreInterval();
+            interval.ReadDurable(reader);
+            interval.ThreadIndex = reader.ReadInt32();
+            return interval;
+        }
+    }
+
+    public class CoreTimeline
+    {
+        public uint Core { get; set; }
+        public List<CoreInterval> Intervals { get; set; }
+
+        // Ticks spent running our threads
+        public long WorkTime { get; private set; }
+
+        // Ticks stolen by other processes
+        public long OtherProcessTime { get; private set; }
+
+        public static CoreTimeline Read(BinaryReader reader)
+        {
+            CoreTimeline timeline = new CoreTimeline();
+            timeline.Core = reader.ReadUInt32();
+
+            int count = reader.ReadInt32();
+            timeline.Intervals = new List<CoreInterval>(count);
+
+            for (int i = 0; i < count; ++i)
+            {
+                CoreInterval interval = CoreInterval.Read(reader);
+                timeline.Intervals.Add(interval);
+
+                if (interval.IsOtherProcess)
+                    timeline.OtherProcessTime += interval.Finish - interval.Start;
+                else
+                    timeline.WorkTime += interval.Finish - interval.Start;
+            }
+
+            return timeline;
+        }
+    }
+
+    // Per-CPU occupancy of the capture: which of our threads ran on which core and the time taken by other processes
+    public class CoreTimelineBoard : IResponseHolder
+    {
+        public override DataResponse Response { get; set; }
+        public FrameGroup Group { get; set; }
+
+        public List<CoreTimeline> Cores { get; set; }
+
+        // Thread index => number of times the thread was resumed on another core
+        public Dictionary<int, int> Migrations { get; private set; }
+
+        public CoreTimelineBoard(DataResponse response, FrameGroup group)
+        {
+            Group = group;
+            Response = response;
+
+            int count = response.Reader.ReadInt32();
+            Cores = new List<CoreTimeline>(count);
+
+            for (int i = 0; i < count; ++i)
+            {
+                Cores.Add(CoreTimeline.Read(response.Reader));
+            }
+
+            CalculateMigrations();
+        }
+
+        void CalculateMigrations()
+        {
+            Dictionary<int, List<KeyValuePair<long, uint>>> threadSwitches = new Dictionary<int, List<KeyValuePair<long, uint>>>();
+
+            foreach (CoreTimeline timeline in Cores)
+            {
+                foreach (CoreInterval interval in timeline.Intervals)
+                {
+                    if (interval.IsOtherProcess)
+                        continue;
+
+                    List<KeyValuePair<long, uint>> switches;
+                    if (!threadSwitches.TryGetValue(interval.ThreadIndex, out switches))
+                    {
+                        switches = new List<KeyValuePair<long, uint>>();
+                        threadSwitches.Add(interval.ThreadIndex, switches);
+                    }
+
+                    switches.Add(new KeyValuePair<long, uint>(interval.Start, timeline.Core));
+                }
+            }
+
+            Migrations = new Dictionary<int, int>();
+
+            foreach (var pair in threadSwitches)
+            {
+                List<KeyValuePair<long, uint>> switches = pair.Value;
+                switches.Sort((a, b) => a.Key.CompareTo(b.Key));
+
+                int migrations = 0;
+                for (int i = 1; i < switches.Count; ++i)
+                {
+                    if (switches[i].Value != switches[i - 1].Value)
+                        ++migrations;
+                }
+
+                Migrations.Add(pair.Key, migrations);
+            }
+        }
+    }
+}
@@ -0,0 +1,108 @@
+﻿using System;
+using System.Collections.Generic;
+using System.IO;
+using System.Linq;
+
+namespace Profiler.Data
+{
+    public class CounterDescription
+    {
+        public int Index { get; set; }
+        public String Name { get; set; }
+        public FileLine Path { get; set; }
+
+        public static CounterDescription Read(BinaryReader reader, int index)
+        {
+            CounterDescription desc = new CounterDescription();
+            desc.Index = index;
+
+            int nameLength = reader.ReadInt32();
+            desc.Name = new String(reader.ReadChars(nameLength));
+
+            int fileLength = reader.ReadInt32();
+            desc.Path = new FileLine(new String(reader.ReadChars(fileLength)), reader.ReadInt32());
+
+            return desc;
+        }
+    }
+
+    public class CounterSample
+    {
+        public long Timestamp { get; set; }
+
+        // Index in CounterBoard.Descriptions
+        public int DescriptionIndex { get; set; }
+        public double Value { get; set; }
+
+        public static CounterSample Read(BinaryReader reader)
+        {
+            CounterSample sample = new CounterSample();
+            sample.Timestamp = reader.ReadInt64();
+            sample.DescriptionIndex = reader.ReadInt32();
+            sample.Value = reader.ReadDouble();
+            return sample;
+        }
+    }
+
+    public class CounterTrack
+    {
+        // -1 - the track belongs to a fiber
+        public int ThreadIndex { get; set; }
+
+        // -1 - the track belongs to a thread
+        public int FiberIndex { get; set; }
+
+        // Ordered by time
+        public List<CounterSample> Samples { get; set; }
+
+        public static CounterTrack Read(BinaryReader reader)
+        {
+            CounterTrack track = new CounterTrack();
+            track.ThreadIndex = reader.ReadInt32();
+            track.FiberIndex = reader.ReadInt32();
+
+            int count = reader.ReadInt32();
+            track.Samples = new List<CounterSample>(count);
+
+            for (int i = 0; i < count; ++i)
+                track.Samples.Add(CounterSample.Read(reader));
+
+            return track;
+        }
+    }
+
+    public class CounterBoard : IResponseHolder
+    {
+        public override DataResponse Response { get; set; }
+        public FrameGroup Group { get; set; }
+
+        public List<CounterDescription> Descriptions { get; set; }
+        public List<CounterTrack> Tracks { get; set; }
+
+        // Values of a single counter from every thread and fiber ordered by time
+        public IEnumerable<CounterSample> GetSeries(CounterDescription description)
+        {
+            return Tracks.SelectMany(track => track.Samples).Where(sample => sample.DescriptionIndex == description.Index).OrderBy(sample => sample.Timestamp);
+        }
+
+        public CounterBoard(DataResponse response, FrameGroup group)
+        {
+            Group = group;
+            Response = response;
+
+            BinaryReader reader = response.Reader;
+
+            int descriptionCount = reader.ReadInt32();
+            Descriptions = new List<CounterDescription>(descriptionCount);
+
+            for (int i = 0; i < descriptionCount; ++i)
+                Descriptions.Add(CounterDescription.Read(reader, i));
+
+            int trackCount = reader.ReadInt32();
+            Tracks = new List<CounterTrack>(trackCount);
+
+            for (int i = 0; i < trackCount; ++i)
+                Tracks.Add(CounterTrack.Read(reader));
+        }
+    }
+}
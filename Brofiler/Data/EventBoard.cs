@@ -101,18 +101,22 @@ namespace Profiler.Data
     public override void Add(EventNode node)
     {
 			base.Add(node);
+
+      // A subsampled event stands for sampleRatio invocations
+      int ratio = Description.GetSampleRatio(node.Entry.Start);
+
       MaxTime = Math.Max(MaxTime, node.Entry.Duration);
-      ChildTime += node.ChildrenDuration;
-			SelfPercent += node.SelfPercent;
-      SelfTime += node.SelfDuration;
+      ChildTime += node.ChildrenDuration * ratio;
+			SelfPercent += node.SelfPercent * ratio;
+      SelfTime += node.SelfDuration * ratio;
 
       if (!node.ExcludeFromTotal)
       {
-        Total += node.Entry.Duration;
+        Total += node.Entry.Duration * ratio;
         //TotalPercent += node.TotalPercent;
       }
 
-      ++Count;
+      Count += ratio;
     }
   }
 
@@ -68,6 +68,28 @@ namespace Profiler.Data
 
         const byte IS_SAMPLING_FLAG = 0x1;
 
+        // Ratio changes of a subsampled description ordered by time, empty if every invocation was recorded
+        private List<KeyValuePair<long, int>> sampleRatios = new List<KeyValuePair<long, int>>();
+
+        public void AddSampleRatio(long timestamp, int ratio)
+        {
+            sampleRatios.Add(new KeyValuePair<long, int>(timestamp, ratio));
+        }
+
+        // Number of invocations represented by an event recorded at the timestamp
+        public int GetSampleRatio(long timestamp)
+        {
+            int ratio = 1;
+            foreach (KeyValuePair<long, int> change in sampleRatios)
+            {
+                if (change.Key > timestamp)
+                    break;
+
+                ratio = change.Value;
+            }
+            return ratio;
+        }
+
 		public void SetOverrideColor(Color color)
 		{
 			Color = color;
@@ -214,6 +236,21 @@ namespace Profiler.Data
             {
                 desc.board.Add(EventDescription.Read(reader, i));
             }
+
+            // Sample ratio log: {index, ratio, timestamp}
+            if (reader.BaseStream.Position < reader.BaseStream.Length)
+            {
+                int ratioCount = reader.ReadInt32();
+                for (int i = 0; i < ratioCount; ++i)
+                {
+                    int index = reader.ReadInt32();
+                    int ratio = reader.ReadInt32();
+                    long timestamp = reader.ReadInt64();
+
+                    if (0 <= index && index < desc.board.Count)
+                        desc.board[index].AddSampleRatio(timestamp, ratio);
+                }
+            }
             return desc;
         }
 
@@ -91,6 +91,11 @@ namespace Profiler.Data
     {
 
 		public SysCallBoard SysCallsBoard { get; protected set; }
+		public CoreTimelineBoard CoreTimeline { get; protected set; }
+		public WaitChainBoard WaitChains { get; protected set; }
+		public LockBoard Locks { get; protected set; }
+		public AllocationBoard Allocations { get; protected set; }
+		public CounterBoard Counters { get; protected set; }
         public EventDescriptionBoard Board { get; set; }
         public ISamplingBoard SamplingBoard { get; set; }
         public List<ThreadData> Threads { get; set; }
@@ -179,6 +184,46 @@ namespace Profiler.Data
 			SysCallsBoard = sysCallsBoard;
 		}
 
+		public void AddCoreTimeline(CoreTimelineBoard coreTimeline)
+		{
+			System.Diagnostics.Debug.Assert(coreTimeline != null && coreTimeline.Response != null, "Invalid CoreTimeline response");
+
+			Responses.Add(coreTimeline.Response);
+			CoreTimeline = coreTimeline;
+		}
+
+		public void AddWaitChains(WaitChainBoard waitChains)
+		{
+			System.Diagnostics.Debug.Assert(waitChains != null && waitChains.Response != null, "Invalid WaitChains response");
+
+			Responses.Add(waitChains.Response);
+			WaitChains = waitChains;
+		}
+
+		public void AddLocks(LockBoard locks)
+		{
+			System.Diagnostics.Debug.Assert(locks != null && locks.Response != null, "Invalid Locks response");
+
+			Responses.Add(locks.Response);
+			Locks = locks;
+		}
+
+		public void AddAllocations(AllocationBoard allocations)
+		{
+			System.Diagnostics.Debug.Assert(allocations != null && allocations.Response != null, "Invalid Allocations response");
+
+			Responses.Add(allocations.Response);
+			Allocations = allocations;
+		}
+
+		public void AddCounters(CounterBoard counters)
+		{
+			System.Diagnostics.Debug.Assert(counters != null && counters.Response != null, "Invalid Counters response");
+
+			Responses.Add(counters.Response);
+			Counters = counters;
+		}
+
 		public void AddCallStackPack(CallstackPack pack)
 		{
 			System.Diagnostics.Debug.Assert(pack != null && pack.Response != null, "Invalid CallstackPack response");
@@ -264,6 +309,12 @@ namespace Profiler.Data
     {
         Dictionary<int, FrameGroup> groups = new Dictionary<int, FrameGroup>();
 
+        // Sent instead of resolved symbols when symbolization is deferred
+        ModuleTable modules = null;
+
+        // Sampling data carries no board id, it follows the frames of the capture it belongs to
+        FrameGroup currentGroup = null;
+
         public void Flush()
         {
             foreach (FrameGroup group in groups.Values)
@@ -279,7 +330,8 @@ namespace Profiler.Data
                 case DataResponse.Type.FrameDescriptionBoard:
                     {
                         EventDescriptionBoard board = EventDescriptionBoard.Read(response);
-                        groups[board.ID] = new FrameGroup(board);
+                        currentGroup = new FrameGroup(board);
+                        groups[board.ID] = currentGroup;
                         break;
                     }
 
@@ -301,7 +353,13 @@ namespace Profiler.Data
 
                 case DataResponse.Type.SamplingFrame:
                     {
-						Add(new SamplingFrame(response));
+						Add(new SamplingFrame(response) { Modules = modules, EventBoard = currentGroup != null ? currentGroup.Board : null });
+                        break;
+                    }
+
+                case DataResponse.Type.ModuleTable:
+                    {
+                        modules = ModuleTable.Create(response);
                         break;
                     }
 
@@ -325,12 +383,64 @@ namespace Profiler.Data
                         break;
                     }
 
+				case DataResponse.Type.CoreTimeline:
+					{
+						int id = response.Reader.ReadInt32();
+						FrameGroup group = groups[id];
+
+						group.AddCoreTimeline(new CoreTimelineBoard(response, group));
+
+						break;
+					}
+
+				case DataResponse.Type.WaitChains:
+					{
+						int id = response.Reader.ReadInt32();
+						FrameGroup group = groups[id];
+
+						group.AddWaitChains(new WaitChainBoard(response, group));
+
+						break;
+					}
+
+				case DataResponse.Type.Locks:
+					{
+						int id = response.Reader.ReadInt32();
+						FrameGroup group = groups[id];
+
+						group.AddLocks(new LockBoard(response, group));
+
+						break;
+					}
+
+				case DataResponse.Type.Allocations:
+					{
+						int id = response.Reader.ReadInt32();
+						FrameGroup group = groups[id];
+
+						group.AddAllocations(new AllocationBoard(response, group));
+
+						break;
+					}
+
+				case DataResponse.Type.Counters:
+					{
+						int id = response.Reader.ReadInt32();
+						FrameGroup group = groups[id];
+
+						group.AddCounters(new CounterBoard(response, group));
+
+						break;
+					}
+
                 case DataResponse.Type.SymbolPack:
                     {
                         int id = response.Reader.ReadInt32();
                         FrameGroup group = groups[id];
 
-                        group.AddSymbolPack(SamplingDescriptionPack.Create(response));
+                        SamplingDescriptionPack pack = SamplingDescriptionPack.Create(response);
+                        pack.Modules = modules;
+                        group.AddSymbolPack(pack);
 
                         break;
                     }
@@ -0,0 +1,132 @@
+﻿using System;
+using System.Collections.Generic;
+using System.IO;
+using System.Linq;
+
+namespace Profiler.Data
+{
+    // Contention of a single lock over the whole capture
+    public class LockStats
+    {
+        public ulong LockId { get; set; }
+
+        public uint WaitCount { get; set; }
+        public long WaitTime { get; set; }
+        public long MaxWait { get; set; }
+
+        public uint HoldCount { get; set; }
+        public long HoldTime { get; set; }
+        public long MaxHold { get; set; }
+
+        public String Name { get { return String.Format("0x{0:x}", LockId); } }
+
+        public double WaitTimeMS { get { return Durable.TicksToMs(WaitTime); } }
+        public double MaxWaitMS { get { return Durable.TicksToMs(MaxWait); } }
+        public double HoldTimeMS { get { return Durable.TicksToMs(HoldTime); } }
+        public double MaxHoldMS { get { return Durable.TicksToMs(MaxHold); } }
+
+        public static LockStats Read(BinaryReader reader)
+        {
+            LockStats stats = new LockStats();
+            stats.LockId = reader.ReadUInt64();
+            stats.WaitCount = reader.ReadUInt32();
+            stats.WaitTime = reader.ReadInt64();
+            stats.MaxWait = reader.ReadInt64();
+            stats.HoldCount = reader.ReadUInt32();
+            stats.HoldTime = reader.ReadInt64();
+            stats.MaxHold = reader.ReadInt64();
+            return stats;
+        }
+    }
+
+    public enum LockIntervalType
+    {
+        Wait = 0,   // Thread was blocked on the lock
+        Hold = 1,   // Thread owned the lock
+    }
+
+    public class LockInterval : Durable
+    {
+        // Index in LockBoard.Locks
+        public int LockIndex { get; set; }
+        public LockIntervalType Type { get; set; }
+
+        // Resolved by LockBoard
+        public LockStats Lock { get; set; }
+
+        public static LockInterval Read(BinaryReader reader)
+        {
+            LockInterval interval = new LockInterval();
+            interval.ReadDurable(reader);
+            interval.LockIndex = reader.ReadInt32();
+            interval.Type = (LockIntervalType)reader.ReadByte();
+            return interval;
+        }
+    }
+
+    public class LockTrack
+    {
+        // -1 - the track belongs to a fiber
+        public int ThreadIndex { get; set; }
+
+        // -1 - the track belongs to a thread
+        public int FiberIndex { get; set; }
+
+        public List<LockInterval> Intervals { get; set; }
+
+        public static LockTrack Read(BinaryReader reader)
+        {
+            LockTrack track = new LockTrack();
+            track.ThreadIndex = reader.ReadInt32();
+            track.FiberIndex = reader.ReadInt32();
+
+            int count = reader.ReadInt32();
+            track.Intervals = new List<LockInterval>(count);
+
+            for (int i = 0; i < count; ++i)
+                track.Intervals.Add(LockInterval.Read(reader));
+
+            return track;
+        }
+    }
+
+    public class LockBoard : IResponseHolder
+    {
+        public override DataResponse Response { get; set; }
+        public FrameGroup Group { get; set; }
+
+        public List<LockStats> Locks { get; set; }
+        public List<LockTrack> Tracks { get; set; }
+
+        // Locks which stalled threads the most go first
+        public IEnumerable<LockStats> ContendedLocks
+        {
+            get { return Locks.Where(stats => stats.WaitTime > 0).OrderByDescending(stats => stats.WaitTime); }
+        }
+
+        public LockBoard(DataResponse response, FrameGroup group)
+        {
+            Group = group;
+            Response = response;
+
+            BinaryReader reader = response.Reader;
+
+            int lockCount = reader.ReadInt32();
+            Locks = new List<LockStats>(lockCount);
+
+            for (int i = 0; i < lockCount; ++i)
+                Locks.Add(LockStats.Read(reader));
+
+            int trackCount = reader.ReadInt32();
+            Tracks = new List<LockTrack>(trackCount);
+
+            for (int i = 0; i < trackCount; ++i)
+                Tracks.Add(LockTrack.Read(reader));
+
+            foreach (LockTrack track in Tracks)
+                foreach (LockInterval interval in track.Intervals)
+                    if (0 <= interval.LockIndex && interval.LockIndex < Locks.Count)
+                        interval.Lock = Locks[interval.LockIndex];
+        }
+    }
+}
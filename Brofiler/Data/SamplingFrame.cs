@@ -82,12 +82,59 @@ namespace Profiler.Data
             return new SamplingDescription() { Module = "Unresolved", FullName = String.Format("0x{0:x}", address), Address = address, Path = FileLine.Empty };
         }
 
+        public static SamplingDescription Create(UInt64 address, SymbolModule module)
+        {
+            SamplingDescription description = new SamplingDescription() { Module = module.Path, Address = address, Path = FileLine.Empty };
+            description.FullName = String.Format("{0}+0x{1:x}", description.ModuleShortName, address - module.Base);
+            return description;
+        }
+
         public override Object GetSharedKey()
         {
             return new SamplingSharedKey(this);
         }
     }
 
+    public class SymbolModule
+    {
+        public UInt64 Base { get; private set; }
+        public UInt64 Size { get; private set; }
+        public String Path { get; private set; }
+        public String BuildId { get; private set; }
+
+        public static SymbolModule Create(BinaryReader reader)
+        {
+            SymbolModule module = new SymbolModule();
+            module.Base = reader.ReadUInt64();
+            module.Size = reader.ReadUInt64();
+            module.Path = System.Text.Encoding.Unicode.GetString(reader.ReadBytes(reader.ReadInt32()));
+            module.BuildId = System.Text.Encoding.ASCII.GetString(reader.ReadBytes(reader.ReadInt32()));
+            return module;
+        }
+    }
+
+    // Modules of the captured addresses: symbols are resolved offline, unresolved addresses are shown as module+offset
+    public class ModuleTable
+    {
+        public List<SymbolModule> Modules { get; private set; }
+
+        public SymbolModule Find(UInt64 address)
+        {
+            return Modules.Find(module => module.Base <= address && address < module.Base + module.Size);
+        }
+
+        public static ModuleTable Create(DataResponse response)
+        {
+            ModuleTable table = new ModuleTable() { Modules = new List<SymbolModule>() };
+
+            uint count = response.Reader.ReadUInt32();
+            for (uint i = 0; i < count; ++i)
+                table.Modules.Add(SymbolModule.Create(response.Reader));
+
+            return table;
+        }
+    }
+
     public abstract class ISamplingBoard
     {
         public abstract SamplingDescription GetDescription(UInt64 address);
@@ -96,6 +143,7 @@ namespace Profiler.Data
     public class SamplingDescriptionBoard : ISamplingBoard
     {
         public Dictionary<UInt64, SamplingDescription> Descriptions { get; private set; }
+        public ModuleTable Modules { get; set; }
 
         protected void Read(BinaryReader reader)
         {
@@ -119,7 +167,16 @@ namespace Profiler.Data
         public override SamplingDescription GetDescription(ulong address)
         {
             SamplingDescription result = null;
-            return Descriptions.TryGetValue(address, out result) ? result : SamplingDescription.UnresolvedDescription;
+            if (Descriptions.TryGetValue(address, out result))
+                return result;
+
+            SymbolModule module = Modules != null ? Modules.Find(address) : null;
+            if (module == null)
+                return SamplingDescription.UnresolvedDescription;
+
+            result = SamplingDescription.Create(address, module);
+            Descriptions[address] = result;
+            return result;
         }
     }
 
@@ -178,9 +235,7 @@ namespace Profiler.Data
         {
             UInt64 address = reader.ReadUInt64();
 
-            SamplingDescription desc = null;
-            if (!board.Descriptions.TryGetValue(address, out desc))
-                desc = SamplingDescription.UnresolvedDescription;
+            SamplingDescription desc = board.GetDescription(address);
 
             UInt32 passed = reader.ReadUInt32();
 
@@ -251,6 +306,7 @@ namespace Profiler.Data
 		public override DataResponse.Type ResponseType { get { return DataResponse.Type.SamplingFrame; } }
 
 		public SamplingDescriptionBoard DescriptionBoard { get; private set; }
+		public ModuleTable Modules { get; set; }
 		public BinaryReader Reader { get; private set; }
 
 		private Board<SamplingBoardItem, SamplingDescription, SamplingNode> board;
@@ -292,6 +348,31 @@ namespace Profiler.Data
             }
 		}
 
+		// Samples which landed inside instrumented scopes, by EventDescription index of the innermost scope
+		private Dictionary<int, SamplingNode> scopeRoots = new Dictionary<int, SamplingNode>();
+		public Dictionary<int, SamplingNode> ScopeRoots
+		{
+			get
+			{
+				Load();
+				return scopeRoots;
+			}
+		}
+
+		// Board of the capture the samples belong to, resolves the keys of ScopeRoots
+		public EventDescriptionBoard EventBoard { get; set; }
+
+		public SamplingNode GetScopeRoot(EventDescription description)
+		{
+			if (EventBoard == null)
+				return null;
+
+			int index = EventBoard.Board.IndexOf(description);
+
+			SamplingNode result = null;
+			return index != -1 && ScopeRoots.TryGetValue(index, out result) ? result : null;
+		}
+
 		public int SampleCount { get; private set; }
 
 		public override string Description { get { return String.Format("{0} Sampling Data", SampleCount); } }
@@ -311,7 +392,19 @@ namespace Profiler.Data
 			if (!IsLoaded)
 			{
 				DescriptionBoard = SamplingDescriptionBoard.Create(Reader);
+				DescriptionBoard.Modules = Modules;
                 Root = SamplingNode.Create(Reader, DescriptionBoard, null);
+
+				// Per-scope trees: {DescriptionIndex, Tree}, older captures end with the main tree
+				if (Reader.BaseStream.Position < Reader.BaseStream.Length)
+				{
+					uint scopeCount = Reader.ReadUInt32();
+					for (uint i = 0; i < scopeCount; ++i)
+					{
+						int index = (int)Reader.ReadUInt32();
+						scopeRoots[index] = SamplingNode.Create(Reader, DescriptionBoard, null);
+					}
+				}
             }
 		}
 
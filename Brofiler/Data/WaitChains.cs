@@ -0,0 +1,114 @@
+﻿using System;
+using System.Collections.Generic;
+using System.IO;
+using System.Linq;
+
+namespace Profiler.Data
+{
+    // All waits of one thread which were ended by the same thread for the same reason
+    public class WaitEdge
+    {
+        public int WaiterThreadIndex { get; set; }
+
+        // -1 - thread of another process, interrupt or unknown
+        public int WakerThreadIndex { get; set; }
+        public SyncReason Reason { get; set; }
+
+        public uint Count { get; set; }
+
+        // Ticks
+        public long WaitTime { get; set; }
+
+        // Ticks of these waits which lie on critical paths of frames
+        public long CriticalTime { get; set; }
+
+        public static WaitEdge Read(BinaryReader reader)
+        {
+            WaitEdge edge = new WaitEdge();
+            edge.WaiterThreadIndex = reader.ReadInt32();
+            edge.WakerThreadIndex = reader.ReadInt32();
+            edge.Reason = (SyncReason)reader.ReadByte();
+            edge.Count = reader.ReadUInt32();
+            edge.WaitTime = reader.ReadInt64();
+            edge.CriticalTime = reader.ReadInt64();
+            return edge;
+        }
+    }
+
+    public enum CriticalPathSegmentType
+    {
+        Run = 0,    // Thread was running
+        Wait = 1,   // Thread was blocked and none of our threads woke it up
+        Ready = 2,  // Thread was woken up, but didn't get a core yet
+    }
+
+    public class CriticalPathSegment : Durable
+    {
+        public int ThreadIndex { get; set; }
+        public CriticalPathSegmentType Type { get; set; }
+
+        public static CriticalPathSegment Read(BinaryReader reader)
+        {
+            CriticalPathSegment segment = new CriticalPathSegment();
+            segment.ReadDurable(reader);
+            segment.ThreadIndex = reader.ReadInt32();
+            segment.Type = (CriticalPathSegmentType)reader.ReadByte();
+            return segment;
+        }
+    }
+
+    // Chain of threads which the end of a frame was waiting on, from the start of the frame to its end
+    public class CriticalPath : Durable
+    {
+        public List<CriticalPathSegment> Segments { get; set; }
+
+        public static CriticalPath Read(BinaryReader reader)
+        {
+            CriticalPath path = new CriticalPath();
+            path.ReadDurable(reader);
+
+            int count = reader.ReadInt32();
+            path.Segments = new List<CriticalPathSegment>(count);
+
+            for (int i = 0; i < count; ++i)
+                path.Segments.Add(CriticalPathSegment.Read(reader));
+
+            return path;
+        }
+    }
+
+    public class WaitChainBoard : IResponseHolder
+    {
+        public override DataResponse Response { get; set; }
+        public FrameGroup Group { get; set; }
+
+        public List<WaitEdge> Edges { get; set; }
+        public List<CriticalPath> Frames { get; set; }
+
+        // Dependencies which serialize frames the most go first
+        public IEnumerable<WaitEdge> CriticalEdges
+        {
+            get { return Edges.Where(edge => edge.CriticalTime > 0).OrderByDescending(edge => edge.CriticalTime); }
+        }
+
+        public WaitChainBoard(DataResponse response, FrameGroup group)
+        {
+            Group = group;
+            Response = response;
+
+            BinaryReader reader = response.Reader;
+
+            int edgeCount = reader.ReadInt32();
+            Edges = new List<WaitEdge>(edgeCount);
+
+            for (int i = 0; i < edgeCount; ++i)
+                Edges.Add(WaitEdge.Read(reader));
+
+            int frameCount = reader.ReadInt32();
+            Frames = new List<CriticalPath>(frameCount);
+
+            for (int i = 0; i < frameCount; ++i)
+                Frames.Add(CriticalPath.Read(reader));
+        }
+    }
+}
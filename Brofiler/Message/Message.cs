@@ -18,8 +18,10 @@ namespace Profiler
 		public const UInt32 NETWORK_PROTOCOL_VERSION_11 = 11; // Added thread synchronization switch to thread ID
  */ 
 		public const UInt32 NETWORK_PROTOCOL_VERSION_12 = 12; // Added separate fiber sync data stream
+		public const UInt32 NETWORK_PROTOCOL_VERSION_13 = 13; // Deduplicated callstacks: stack dictionary + {ThreadID, Timestamp, StackID} samples
+		public const UInt32 NETWORK_PROTOCOL_VERSION_14 = 14; // Paired syscalls per thread + per frame syscall stats
 
-		public const UInt32 NETWORK_PROTOCOL_VERSION = NETWORK_PROTOCOL_VERSION_12;
+		public const UInt32 NETWORK_PROTOCOL_VERSION = NETWORK_PROTOCOL_VERSION_14;
 		public const UInt32 NETWORK_PROTOCOL_MIN_VERSION = NETWORK_PROTOCOL_VERSION_12;
     }
 
@@ -43,6 +45,12 @@ namespace Profiler
             CallstackPack = 8,
 			SyscallPack = 9,
 			FiberSynchronization = 10,
+			Counters = 11,
+			ModuleTable = 12,
+			CoreTimeline = 13,
+			WaitChains = 14,
+			Locks = 15,
+			Allocations = 16,
         }
 
         public Type ResponseType { get; set; }
@@ -130,10 +138,13 @@ namespace Profiler
 
     public enum MessageType
     {
-        Start,
-        Stop,
-        TurnSampling,
-        SetupHook,
+        Start = 0,
+        Stop = 1,
+        TurnSampling = 2,
+        SetupHook = 3,
+        TurnEnabled = 4,
+        SetGroupMask = 5,
+        SetSampleRatio = 6,
     }
 
     public abstract class Message
@@ -147,8 +158,23 @@ namespace Profiler
         }
     }
 
+    public class SamplingSettings
+    {
+        public UInt32 IntervalMicroSeconds = 300;
+        public UInt32 MaxDepth = 0;     // 0 - unlimited
+        public UInt32 SampleBudget = 0; // 0 - unlimited
+    }
+
     class StartMessage : Message
     {
+        // Optional: omitted settings keep the application defaults
+        public SamplingSettings Sampling { get; set; }
+
+        // Application sends raw addresses and the module table instead of resolved symbols
+        public bool DeferSymbols { get; set; }
+
+        const UInt32 DEFER_SYMBOLS = 1 << 0;
+
         public StartMessage()
         {
         }
@@ -161,6 +187,19 @@ namespace Profiler
         public override void Write(BinaryWriter writer)
         {
             base.Write(writer);
+
+            if (Sampling != null || DeferSymbols)
+            {
+                SamplingSettings sampling = Sampling ?? new SamplingSettings();
+                writer.Write(sampling.IntervalMicroSeconds);
+                writer.Write(sampling.MaxDepth);
+                writer.Write(sampling.SampleBudget);
+            }
+
+            if (DeferSymbols)
+            {
+                writer.Write(DEFER_SYMBOLS);
+            }
         }
     }
 
@@ -220,4 +259,75 @@ namespace Profiler
         }
     }
 
+    class TurnEnabledMessage : Message
+    {
+        // -1 - all descriptions
+        Int32 eventID;
+        bool isEnabled;
+
+        public TurnEnabledMessage(Int32 eventID, bool isEnabled)
+        {
+            this.eventID = eventID;
+            this.isEnabled = isEnabled;
+        }
+
+        public override Int32 GetMessageType()
+        {
+            return (Int32)MessageType.TurnEnabled;
+        }
+
+        public override void Write(BinaryWriter writer)
+        {
+            base.Write(writer);
+            writer.Write(eventID);
+            writer.Write(isEnabled);
+        }
+    }
+
+    class SetGroupMaskMessage : Message
+    {
+        UInt32 groupMask;
+
+        public SetGroupMaskMessage(UInt32 groupMask)
+        {
+            this.groupMask = groupMask;
+        }
+
+        public override Int32 GetMessageType()
+        {
+            return (Int32)MessageType.SetGroupMask;
+        }
+
+        public override void Write(BinaryWriter writer)
+        {
+            base.Write(writer);
+            writer.Write(groupMask);
+        }
+    }
+
+    class SetSampleRatioMessage : Message
+    {
+        // -1 - all descriptions
+        Int32 eventID;
+        UInt32 ratio;
+
+        public SetSampleRatioMessage(Int32 eventID, UInt32 ratio)
+        {
+            this.eventID = eventID;
+            this.ratio = ratio;
+        }
+
+        public override Int32 GetMessageType()
+        {
+            return (Int32)MessageType.SetSampleRatio;
+        }
+
+        public override void Write(BinaryWriter writer)
+        {
+            base.Write(writer);
+            writer.Write(eventID);
+            writer.Write(ratio);
+        }
+    }
+
 }
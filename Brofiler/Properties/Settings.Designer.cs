@@ -46,5 +46,53 @@ namespace Profiler.Properties {
                 this["DefaultPort"] = value;
             }
         }
+        
+        [global::System.Configuration.UserScopedSettingAttribute()]
+        [global::System.Diagnostics.DebuggerNonUserCodeAttribute()]
+        [global::System.Configuration.DefaultSettingValueAttribute("300")]
+        public uint SamplingInterval {
+            get {
+                return ((uint)(this["SamplingInterval"]));
+            }
+            set {
+                this["SamplingInterval"] = value;
+            }
+        }
+        
+        [global::System.Configuration.UserScopedSettingAttribute()]
+        [global::System.Diagnostics.DebuggerNonUserCodeAttribute()]
+        [global::System.Configuration.DefaultSettingValueAttribute("0")]
+        public uint SamplingMaxDepth {
+            get {
+                return ((uint)(this["SamplingMaxDepth"]));
+            }
+            set {
+                this["SamplingMaxDepth"] = value;
+            }
+        }
+        
+        [global::System.Configuration.UserScopedSettingAttribute()]
+        [global::System.Diagnostics.DebuggerNonUserCodeAttribute()]
+        [global::System.Configuration.DefaultSettingValueAttribute("0")]
+        public uint SamplingBudget {
+            get {
+                return ((uint)(this["SamplingBudget"]));
+            }
+            set {
+                this["SamplingBudget"] = value;
+            }
+        }
+        
+        [global::System.Configuration.UserScopedSettingAttribute()]
+        [global::System.Diagnostics.DebuggerNonUserCodeAttribute()]
+        [global::System.Configuration.DefaultSettingValueAttribute("False")]
+        public bool DeferSymbols {
+            get {
+                return ((bool)(this["DeferSymbols"]));
+            }
+            set {
+                this["DeferSymbols"] = value;
+            }
+        }
     }
 }
@@ -0,0 +1,106 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Windows;
+using Profiler.Data;
+using System.Windows.Media;
+using Profiler.DirectX;
+
+namespace Profiler
+{
+    // Lock waits & holds of a single thread (or fiber)
+    public class LocksThreadRow : ThreadRow
+    {
+        String TrackName { get; set; }
+        LockTrack Track { get; set; }
+
+        Mesh Mesh { get; set; }
+
+        static Color WaitColor = Colors.OrangeRed;
+        static Color HoldColor = Colors.LimeGreen;
+
+        public LocksThreadRow(FrameGroup group, String trackName, LockTrack track)
+        {
+            Group = group;
+            TrackName = trackName;
+            Track = track;
+        }
+
+        public override double Height { get { return RenderParams.BaseHeight; } }
+        public override string Name { get { return String.Format("Locks: {0}", TrackName); } }
+
+        public override void BuildMesh(DirectX.DirectXCanvas canvas, ThreadScroll scroll)
+        {
+            DirectX.DynamicMesh builder = canvas.CreateMesh();
+
+            // Holds go first, so the waits nested into them stay visible
+            foreach (LockIntervalType type in new LockIntervalType[] { LockIntervalType.Hold, LockIntervalType.Wait })
+            {
+                Color color = type == LockIntervalType.Wait ? WaitColor : HoldColor;
+
+                foreach (LockInterval lockInterval in Track.Intervals)
+                {
+                    if (lockInterval.Type != type)
+                        continue;
+
+                    Interval interval = scroll.TimeToUnit(lockInterval);
+                    builder.AddRect(new Rect(interval.Left, 0.0, interval.Width, 1.0), color);
+                }
+            }
+
+            Mesh = builder.Freeze(canvas.RenderDevice);
+        }
+
+        public override void Render(DirectX.DirectXCanvas canvas, ThreadScroll scroll, DirectXCanvas.Layer layer)
+        {
+            if (layer == DirectXCanvas.Layer.Background && Mesh != null)
+            {
+                SharpDX.Matrix world = SharpDX.Matrix.Scaling((float)scroll.Zoom, (float)((Height - 2.0 * RenderParams.BaseMargin) / scroll.Height), 1.0f);
+                world.TranslationVector = new SharpDX.Vector3(-(float)(scroll.ViewUnit.Left * scroll.Zoom), (float)((Offset + 1.0 * RenderParams.BaseMargin) / scroll.Height), 0.0f);
+
+                Mesh.World = world;
+                canvas.Draw(Mesh);
+            }
+        }
+
+        LockInterval FindInterval(Point point, ThreadScroll scroll)
+        {
+            ITick tick = scroll.PixelToTime(point.X);
+
+            LockInterval result = null;
+
+            foreach (LockInterval lockInterval in Track.Intervals)
+            {
+                if (lockInterval.Intersect(tick.Start))
+                {
+                    result = lockInterval;
+
+                    // Waits are drawn on top of holds
+                    if (lockInterval.Type == LockIntervalType.Wait)
+                        break;
+                }
+            }
+
+            return result;
+        }
+
+        public override void OnMouseMove(Point point, ThreadScroll scroll) { }
+
+        public override void OnMouseHover(Point point, ThreadScroll scroll, List<object> dataContext)
+        {
+            LockInterval lockInterval = FindInterval(point, scroll);
+            if (lockInterval != null)
+            {
+                dataContext.Add(lockInterval);
+
+                if (lockInterval.Lock != null)
+                    dataContext.Add(lockInterval.Lock);
+            }
+
+            if (Group.Locks != null)
+                dataContext.Add(Group.Locks);
+        }
+
+        public override void OnMouseClick(Point point, ThreadScroll scroll) { }
+        public override void ApplyFilter(DirectXCanvas canvas, ThreadScroll scroll, HashSet<EventDescription> descriptions) { }
+    }
+}
@@ -98,6 +98,23 @@ namespace Profiler
                 TextColor = Colors.Black
             });
 
+            Dictionary<int, LockTrack> threadLocks = new Dictionary<int, LockTrack>();
+            List<LockTrack> fiberLocks = new List<LockTrack>();
+
+            if (group.Locks != null)
+            {
+                foreach (LockTrack track in group.Locks.Tracks)
+                {
+                    if (track.Intervals.Count == 0)
+                        continue;
+
+                    if (track.ThreadIndex >= 0)
+                        threadLocks[track.ThreadIndex] = track;
+                    else
+                        fiberLocks.Add(track);
+                }
+            }
+
             for (int i = 0; i < Math.Min(group.Board.Threads.Count, group.Threads.Count); ++i)
             {
                 ThreadDescription thread = group.Board.Threads[i];
@@ -121,6 +138,16 @@ namespace Profiler
                     row.EventNodeHover += Row_EventNodeHover;
                     row.EventNodeSelected += Row_EventNodeSelected;
                 }
+
+                LockTrack lockTrack = null;
+                if (threadLocks.TryGetValue(i, out lockTrack))
+                    rows.Add(new LocksThreadRow(group, thread.Name, lockTrack));
+            }
+
+            foreach (LockTrack lockTrack in fiberLocks)
+            {
+                String fiberName = lockTrack.FiberIndex < group.Board.Fibers.Count ? String.Format("Fiber 0x{0:x}", group.Board.Fibers[lockTrack.FiberIndex].fiberID) : String.Format("Fiber {0}", lockTrack.FiberIndex);
+                rows.Add(new LocksThreadRow(group, fiberName, lockTrack));
             }
 
             scroll.TimeSlice = group.Board.TimeSlice;
@@ -479,7 +479,16 @@ namespace Profiler
             ProfilerClient.Get().IpAddress = platform.IP;
             ProfilerClient.Get().Port = platform.Port;
 
-            StartMessage message = new StartMessage();
+            StartMessage message = new StartMessage()
+            {
+                Sampling = new SamplingSettings()
+                {
+                    IntervalMicroSeconds = Properties.Settings.Default.SamplingInterval,
+                    MaxDepth = Properties.Settings.Default.SamplingMaxDepth,
+                    SampleBudget = Properties.Settings.Default.SamplingBudget,
+                },
+                DeferSymbols = Properties.Settings.Default.DeferSymbols,
+            };
             if (ProfilerClient.Get().SendMessage(message))
             {
                 Application.Current.Dispatcher.BeginInvoke(new Action(() =>
@@ -0,0 +1,110 @@
+#include "AllocationCollector.h"
+#include "Core.h"
+
+#include <algorithm>
+#include <map>
+#include <unordered_map>
+
+namespace Brofiler {
+
+////////////////////////////////////////////////////////////
+//
+//    AllocationCollector
+//
+/////
+
+namespace {
+
+struct LiveBlock {
+    uint64_t size;
+    uint32_t descriptionIndex;
+};
+
+struct AllocationStat {
+    uint64_t allocatedBytes  = 0;
+    uint32_t allocationCount = 0;
+    uint64_t peakLiveBytes   = 0;
+};
+
+} // namespace
+
+bool AllocationCollector::Serialize (OutputDataStream & stream, const std::vector<const EventStorage *> & storages, const std::vector<EventTime> & frames) {
+    std::vector<AllocationData> records;
+
+    for (const EventStorage * storage : storages) {
+        storage->allocationBuffer.ForEach([&](const AllocationData & data) {
+            records.push_back(data);
+        });
+    }
+
+    if (records.empty())
+        return false;
+
+    // A block may be freed by another thread, so the buffers are merged into a single timeline
+    std::stable_sort(records.begin(), records.end(), [](const AllocationData & a, const AllocationData & b) {
+        return a.timestamp < b.timestamp;
+    });
+
+    std::unordered_map<const void *, LiveBlock> liveBlocks;
+    std::unordered_map<uint32_t, uint64_t> liveBytes; // Description index => bytes allocated in the scope and not freed yet
+    std::vector<std::map<uint32_t, AllocationStat>> frameStats(frames.size());
+
+    size_t frameIndex = 0;
+
+    for (const AllocationData & data : records) {
+        while (frameIndex < frames.size() && frames[frameIndex].finish < data.timestamp) {
+            ++frameIndex;
+        }
+
+        std::map<uint32_t, AllocationStat> * stats = nullptr;
+        if (frameIndex < frames.size() && frames[frameIndex].start <= data.timestamp) {
+            stats = &frameStats[frameIndex];
+        }
+
+        auto it = liveBlocks.find(data.pointer);
+
+        // Free of a block allocated before the capture is not found. A live pointer which is allocated again lost its free.
+        if (it != liveBlocks.end()) {
+            uint64_t & bytes = liveBytes[it->second.descriptionIndex];
+
+            if (stats != nullptr) {
+                AllocationStat & stat = (*stats)[it->second.descriptionIndex];
+                stat.peakLiveBytes = std::max(stat.peakLiveBytes, bytes);
+            }
+
+            bytes -= it->second.size;
+            liveBlocks.erase(it);
+        }
+
+        if (data.type == AllocationData::ALLOC) {
+            uint32_t descriptionIndex = data.scope ? data.scope->index : EventDescription::INVALID_INDEX;
+
+            LiveBlock block = { data.size, descriptionIndex };
+            liveBlocks[data.pointer] = block;
+
+            uint64_t & bytes = liveBytes[descriptionIndex];
+            bytes += data.size;
+
+            if (stats != nullptr) {
+                AllocationStat & stat = (*stats)[descriptionIndex];
+                stat.allocatedBytes += data.size;
+                ++stat.allocationCount;
+                stat.peakLiveBytes = std::max(stat.peakLiveBytes, bytes);
+            }
+        }
+    }
+
+    stream << (uint32_t)frames.size();
+
+    for (size_t i = 0; i < frames.size(); ++i) {
+        stream << frames[i] << (uint32_t)frameStats[i].size();
+
+        for (auto it = frameStats[i].begin(); it != frameStats[i].end(); ++it) {
+            stream << it->first << it->second.allocatedBytes << it->second.allocationCount << it->second.peakLiveBytes;
+        }
+    }
+
+    return true;
+}
+
+} // Brofiler
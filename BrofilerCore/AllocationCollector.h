@@ -0,0 +1,51 @@
+#pragma once
+#include <MTTypes.h>
+
+#include "Brofiler.h"
+#include "MemoryPool.h"
+#include "Serialization.h"
+
+#include <vector>
+
+namespace Brofiler {
+
+struct EventStorage;
+
+
+////////////////////////////////////////////////////////////
+//
+//    AllocationData
+//
+/////
+
+struct AllocationData {
+    enum Type : uint8_t {
+        ALLOC = 0,
+        FREE  = 1,
+    };
+
+    int64_t                  timestamp;
+    const void *             pointer;
+    uint64_t                 size;  // Not used by FREE: the size is taken from the matching ALLOC
+    const EventDescription * scope; // Innermost scope of the calling thread, nullptr - outside of scopes
+    Type                     type;
+};
+
+using AllocationBuffer = MemoryPool<AllocationData, 256>;
+
+
+////////////////////////////////////////////////////////////
+//
+//    AllocationCollector
+//
+/////
+
+// Allocations are recorded into the buffer of the calling thread (EventStorage::allocationBuffer) by Allocation::Alloc/Free,
+// the collector matches blocks across threads and aggregates per frame statistics of every scope when the capture is dumped.
+class AllocationCollector {
+public:
+    // Packet: {FrameCount, {Start, Finish, StatCount, {DescriptionIndex (-1 - outside of scopes), AllocatedBytes, AllocationCount, PeakLiveBytes}[]}[]}
+    bool Serialize (OutputDataStream & stream, const std::vector<const EventStorage *> & storages, const std::vector<EventTime> & frames);
+};
+
+} // Brofiler
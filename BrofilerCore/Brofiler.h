@@ -1,6 +1,7 @@
 #pragma once
 
 #include <stdint.h>
+#include <type_traits>
 
 ////////////////////////////////////////////////////////////
 //
@@ -61,6 +62,28 @@
 
 #define BRO_UNUSED(x) (void)(x)
 
+// Static EventDescriptions are listed in a dedicated linker section and registered once on
+// Core startup. GCC refuses to mix COMDAT (inline/template functions) and regular data in one
+// named section, so there the entry is emitted by inline assembly and the section is walked
+// through its __start_/__stop_ symbols. Position independent code of shared objects can't take
+// the address as an immediate (and isn't covered by the executable's section anyway), such
+// descriptions register themselves on the first invocation.
+#if BRO_MSVC
+#   pragma section("brodesc$m", read)
+#   define BRO_DESCRIPTION_SECTION_ENTRY(DESCRIPTION)                                                    \
+        __declspec(allocate("brodesc$m"))                                                                 \
+        static ::Brofiler::EventDescription * const BRO_UNIQUE_SYM(auto_description_entry_) = &DESCRIPTION; \
+        BRO_UNUSED(BRO_UNIQUE_SYM(auto_description_entry_));
+#elif !defined(__APPLE__) && (!defined(__PIC__) || defined(__PIE__))
+#   define BRO_DESCRIPTION_SECTION_ENTRY(DESCRIPTION)                                           \
+        __asm__ (".pushsection brodesc, \"aw\"\n\t.balign %c1\n\t.dc.a %c0\n\t.popsection" \
+                 : : "i" (&DESCRIPTION), "i" (sizeof(void *)));
+#else
+#   define BRO_DESCRIPTION_SECTION_ENTRY(DESCRIPTION)                                                                         \
+        static const bool BRO_UNIQUE_SYM(auto_description_registered_) = ::Brofiler::EventDescription::Register(&DESCRIPTION); \
+        BRO_UNUSED(BRO_UNIQUE_SYM(auto_description_registered_));
+#endif
+
 namespace Brofiler {
 
 ////////////////////////////////////////////////////////////
@@ -218,6 +241,22 @@ struct Color {
 };
 
 
+////////////////////////////////////////////////////////////
+//
+//    Group
+//
+/////
+
+// Subsystem bit mask of an EventDescription. Any bit above Default is free for user groups.
+struct Group {
+    enum Enum : uint32_t {
+        None    = 0x00000000,
+        Default = 0x00000001,
+        All     = 0xFFFFFFFF,
+    };
+};
+
+
 ////////////////////////////////////////////////////////////
 //
 //    Forward Declarations
@@ -305,7 +344,11 @@ struct BRO_API FiberSyncData : public EventTime {
 /////
 
 struct BRO_API EventDescription {
-    bool isSampling;		
+    bool     isSampling;
+    bool     isEnabled;     // Effective flag: the per-description switch combined with the group mask
+    bool     isSwitchedOn;  // Per-description switch set by TurnEnabled, kept apart from the group mask
+    uint32_t sampleRatio; // Records only every Nth invocation of the scope (1 - record all)
+    uint32_t sampleSlot;  // Invocation counter used for subsampling, owned while sampleRatio > 1 (see EventDescriptionBoard::SetSampleRatio)
 
     // HOT  \\
     // Have to place "hot" variables at the beginning of the class (here will be some padding)
@@ -316,8 +359,30 @@ struct BRO_API EventDescription {
     uint32_t     line;
     uint32_t     index;
     uint32_t     color;
+    uint32_t     group;
+
+    enum : uint32_t { INVALID_INDEX = 0xFFFFFFFF, MAX_SAMPLE_SLOTS = 256 };
+
+    // Constant initialization: function-local statics built this way have no guard variable
+    constexpr EventDescription (const char * eventName, const char * fileName, uint32_t fileLine, uint32_t eventColor = Color::Null, uint32_t eventGroup = Group::Default)
+        : isSampling(false)
+        , isEnabled(true)
+        , isSwitchedOn(true)
+        , sampleRatio(1)
+        , sampleSlot(INVALID_INDEX)
+        , name(eventName)
+        , file(fileName)
+        , line(fileLine)
+        , index(INVALID_INDEX)
+        , color(eventColor)
+        , group(eventGroup)
+    {
+    }
+
+    static EventDescription * Create (const char * eventName, const char * fileName, uint32_t fileLine, uint32_t eventColor = Color::Null, uint32_t eventGroup = Group::Default);
 
-    static EventDescription * Create (const char * eventName, const char * fileName, uint32_t fileLine, uint32_t eventColor = Color::Null);
+    // Registers a static description which isn't listed in the linker section
+    static bool Register (EventDescription * description);
 
 private:
 	friend class EventDescriptionBoard;
@@ -360,6 +425,134 @@ struct BRO_API Category : public Event {
 };
 
 
+////////////////////////////////////////////////////////////
+//
+//    CounterDescription
+//
+/////
+
+struct BRO_API CounterDescription {
+    const char * name;
+    const char * file;
+    uint32_t     line;
+    uint32_t     index;
+
+    enum : uint32_t { INVALID_INDEX = 0xFFFFFFFF };
+
+    // The index is assigned by CounterDescriptionBoard when the first sample is dumped
+    constexpr CounterDescription (const char * counterName, const char * fileName, uint32_t fileLine)
+        : name(counterName)
+        , file(fileName)
+        , line(fileLine)
+        , index(INVALID_INDEX)
+    {
+    }
+};
+
+
+////////////////////////////////////////////////////////////
+//
+//    Counter
+//
+/////
+
+// Records a value of the counter track on the calling thread
+struct BRO_API Counter {
+    static void Set (CounterDescription & description, double value);
+};
+
+
+////////////////////////////////////////////////////////////
+//
+//    Argument
+//
+/////
+
+// Named value attached to the innermost event which is open on the calling thread,
+// dropped if that scope isn't recorded (disabled or subsampled away).
+// Strings are copied and truncated to Argument::MAX_STRING_LENGTH characters.
+struct BRO_API Argument {
+    enum : uint32_t { MAX_STRING_LENGTH = 23 };
+
+    static void AddInteger (const char * name, int64_t value);
+    static void AddFloat (const char * name, double value);
+    static void AddString (const char * name, const char * value);
+
+    static void Add (const char * name, int value)                { AddInteger(name, (int64_t)value); }
+    static void Add (const char * name, unsigned int value)       { AddInteger(name, (int64_t)value); }
+    static void Add (const char * name, long value)               { AddInteger(name, (int64_t)value); }
+    static void Add (const char * name, unsigned long value)      { AddInteger(name, (int64_t)value); }
+    static void Add (const char * name, long long value)          { AddInteger(name, (int64_t)value); }
+    static void Add (const char * name, unsigned long long value) { AddInteger(name, (int64_t)value); }
+    static void Add (const char * name, float value)              { AddFloat(name, (double)value); }
+    static void Add (const char * name, double value)             { AddFloat(name, value); }
+    static void Add (const char * name, const char * value)       { AddString(name, value); }
+};
+
+
+////////////////////////////////////////////////////////////
+//
+//    Lock
+//
+/////
+
+// Contention of user locks on the calling thread. A wait ends with Acquired, or with WaitEnd if the lock was not taken
+// (e.g. try-lock timeout). A hold lasts from Acquired to Released. Locks are identified by address or any unique id.
+struct BRO_API Lock {
+    static void WaitBegin (uint64_t lockId);
+    static void WaitEnd (uint64_t lockId);
+    static void Acquired (uint64_t lockId);
+    static void Released (uint64_t lockId);
+
+    static uint64_t GetId (const volatile void * lock) { return (uint64_t)(uintptr_t)lock; }
+    static uint64_t GetId (uint64_t lockId)            { return lockId; }
+};
+
+
+////////////////////////////////////////////////////////////
+//
+//    LockGuard
+//
+/////
+
+// Instrumented std::lock_guard for any type with lock/try_lock/unlock, uncontended acquisitions record no wait
+template<class Mutex>
+struct LockGuard {
+    Mutex & mutex;
+
+    explicit LockGuard (Mutex & m) : mutex(m) {
+        if (!mutex.try_lock()) {
+            Lock::WaitBegin(Lock::GetId(&mutex));
+            mutex.lock();
+        }
+        Lock::Acquired(Lock::GetId(&mutex));
+    }
+
+    ~LockGuard () {
+        // Before unlock: the hold of the next owner must not start before this one ends
+        Lock::Released(Lock::GetId(&mutex));
+        mutex.unlock();
+    }
+
+    LockGuard (const LockGuard &) = delete;
+    LockGuard & operator= (const LockGuard &) = delete;
+};
+
+
+////////////////////////////////////////////////////////////
+//
+//    Allocation
+//
+/////
+
+// Hooks for malloc/free wrappers or custom allocators. An allocation is attributed to the innermost scope of the
+// calling thread, a block may be freed on any thread. Reentrant calls made while the profiler records are ignored.
+struct BRO_API Allocation {
+    static void Alloc (const void * pointer, uint64_t size);
+    static void Free (const void * pointer);
+};
+
+
 ////////////////////////////////////////////////////////////
 //
 //    ThreadScope
@@ -385,9 +578,13 @@ struct ThreadScope {
 //
 /////
 
-#define BRO_FILE_EVENT_SCOPED(NAME)                                                                                                                        \
-        static ::Brofiler::EventDescription * BRO_UNIQUE_SYM(auto_description_) = ::Brofiler::EventDescription::Create(NAME, __FILE__, __LINE__); \
-    ::Brofiler::Event BRO_UNIQUE_SYM(auto_event_)( *(BRO_UNIQUE_SYM(auto_description_)) );
+#define BRO_STATIC_DESCRIPTION(NAME, COLOR, GROUP)                                                                    \
+    static ::Brofiler::EventDescription BRO_UNIQUE_SYM(auto_description_)(NAME, __FILE__, __LINE__, COLOR, GROUP); \
+    BRO_DESCRIPTION_SECTION_ENTRY(BRO_UNIQUE_SYM(auto_description_))
+
+#define BRO_FILE_EVENT_SCOPED(NAME)                                                       \
+    BRO_STATIC_DESCRIPTION(NAME, ::Brofiler::Color::Null, ::Brofiler::Group::Default) \
+    ::Brofiler::Event BRO_UNIQUE_SYM(auto_event_)( BRO_UNIQUE_SYM(auto_description_) );
 
 #define BRO_FILE_SCOPED() BRO_FILE_EVENT_SCOPED(BRO_DECORATED_FUNCTION)
 
@@ -395,9 +592,13 @@ struct ThreadScope {
 
 #define BRO_FILE_CUSTOM_EVENT(DESCRIPTION) ::Brofiler::Event BRO_UNIQUE_SYM(auto_event_)( *DESCRIPTION );
 
-#define BRO_FILE_CATEGORY_SCOPED(NAME, COLOR)                                                                                                               \
-    static ::Brofiler::EventDescription * BRO_UNIQUE_SYM(auto_description_) = ::Brofiler::EventDescription::Create(NAME, __FILE__, __LINE__, COLOR); \
-    ::Brofiler::Category BRO_UNIQUE_SYM(auto_event_)( *(BRO_UNIQUE_SYM(auto_description_)) );
+#define BRO_FILE_CATEGORY_SCOPED(NAME, COLOR)                             \
+    BRO_STATIC_DESCRIPTION(NAME, COLOR, ::Brofiler::Group::Default) \
+    ::Brofiler::Category BRO_UNIQUE_SYM(auto_event_)( BRO_UNIQUE_SYM(auto_description_) );
+
+#define BRO_FILE_GROUP_SCOPED(NAME, GROUP)                                    \
+    BRO_STATIC_DESCRIPTION(NAME, ::Brofiler::Color::Null, GROUP) \
+    ::Brofiler::Event BRO_UNIQUE_SYM(auto_event_)( BRO_UNIQUE_SYM(auto_description_) );
 
 #define BRO_FILE_FRAME_SCOPED(FRAME_NAME)                                         \
     static ::Brofiler::ThreadScope BRO_UNIQUE_SYM(auto_main_thread_)(FRAME_NAME); \
@@ -409,15 +610,49 @@ struct ThreadScope {
 #define BRO_FILE_START_THREAD(FRAME_NAME) ::Brofiler::RegisterThread(FRAME_NAME);
 
 #define BRO_FILE_STOP_THREAD() ::Brofiler::UnRegisterThread();
+
+#define BRO_FILE_ARG(NAME, VALUE) ::Brofiler::Argument::Add(NAME, VALUE);
+
+#define BRO_FILE_COUNTER(NAME, VALUE) {                                                                                \
+    static ::Brofiler::CounterDescription BRO_UNIQUE_SYM(auto_counter_)(NAME, __FILE__, __LINE__); \
+    ::Brofiler::Counter::Set(BRO_UNIQUE_SYM(auto_counter_), (double)(VALUE));                       \
+}
+
+#define BRO_FILE_LOCK_WAIT_BEGIN(LOCK) ::Brofiler::Lock::WaitBegin(::Brofiler::Lock::GetId(LOCK));
+
+#define BRO_FILE_LOCK_WAIT_END(LOCK) ::Brofiler::Lock::WaitEnd(::Brofiler::Lock::GetId(LOCK));
+
+#define BRO_FILE_LOCK_ACQUIRED(LOCK) ::Brofiler::Lock::Acquired(::Brofiler::Lock::GetId(LOCK));
+
+#define BRO_FILE_LOCK_RELEASED(LOCK) ::Brofiler::Lock::Released(::Brofiler::Lock::GetId(LOCK));
+
+#define BRO_FILE_LOCK_SCOPED(MUTEX) ::Brofiler::LockGuard<std::remove_reference<decltype(MUTEX)>::type> BRO_UNIQUE_SYM(auto_lock_)(MUTEX);
+
+#define BRO_FILE_ALLOC(POINTER, SIZE) ::Brofiler::Allocation::Alloc(POINTER, (uint64_t)(SIZE));
+
+#define BRO_FILE_FREE(POINTER) ::Brofiler::Allocation::Free(POINTER);
 																		
 #else
+#   include <mutex>
 #   define BRO_FILE_EVENT_SCOPED(NAME)
 #   define BRO_FILE_SCOPED()
 #   define BRO_FILE_INLINE_EVENT(NAME, CODE) { CODE; }
 #   define BRO_FILE_CUSTOM_EVENT(DESCRIPTION)
 #   define BRO_FILE_CATEGORY_SCOPED(NAME, COLOR)
+#   define BRO_FILE_GROUP_SCOPED(NAME, GROUP)
 #   define BRO_FILE_FRAME_SCOPED(NAME)
 #   define BRO_FILE_THREAD_SCOPED(FRAME_NAME)
 #   define BRO_FILE_START_THREAD(FRAME_NAME)
 #   define BRO_FILE_STOP_THREAD()
+#   define BRO_FILE_ARG(NAME, VALUE)
+#   define BRO_FILE_COUNTER(NAME, VALUE)
+#   define BRO_FILE_LOCK_WAIT_BEGIN(LOCK)
+#   define BRO_FILE_LOCK_WAIT_END(LOCK)
+#   define BRO_FILE_LOCK_ACQUIRED(LOCK)
+#   define BRO_FILE_LOCK_RELEASED(LOCK)
+#   define BRO_FILE_LOCK_SCOPED(MUTEX) BRO_FILE_LOCK_SCOPED_IMPL(MUTEX, __LINE__)
+#   define BRO_FILE_LOCK_SCOPED_IMPL(MUTEX, LINE) BRO_FILE_LOCK_SCOPED_IMPL2(MUTEX, LINE)
+#   define BRO_FILE_LOCK_SCOPED_IMPL2(MUTEX, LINE) ::std::lock_guard<std::remove_reference<decltype(MUTEX)>::type> auto_lock_##LINE(MUTEX);
+#   define BRO_FILE_ALLOC(POINTER, SIZE)
+#   define BRO_FILE_FREE(POINTER)
 #endif
@@ -12,91 +12,113 @@ namespace Brofiler {
 //
 /////
 
-void CallstackCollector::Add (const CallstackDesc & desc) {
-    if (uint64 * storage = callstacksPool.TryAdd(desc.count + 3)) {
-        storage[0] = desc.threadID;
-        storage[1] = desc.timestamp;
-        storage[2] = desc.count;
+CallstackCollector::CallstackCollector () {
+    RehashStacks(1024);
+}
 
-        for (uint64_t i = 0; i < desc.count; ++i) {
-            storage[3 + i] = desc.callstack[desc.count - i - 1];
-        }
+static uint64 HashCallstack (const CallstackDesc & desc) {
+    // Rolling hash over the frames in stored (reversed) order
+    uint64 hash = 0xcbf29ce484222325ull ^ desc.count;
+    for (uint64_t i = 0; i < desc.count; ++i) {
+        hash = (hash ^ desc.callstack[desc.count - i - 1]) * 0x100000001b3ull;
+        hash ^= hash >> 29;
     }
-    else {
-        uint64 & item0 = callstacksPool.Add();
-        uint64 & item1 = callstacksPool.Add();
-        uint64 & item2 = callstacksPool.Add();
+    return hash;
+}
 
-        item0 = desc.threadID;
-        item1 = desc.timestamp;
-        item2 = desc.count;
+void CallstackCollector::RehashStacks (size_t capacity) {
+    stackTable.assign(capacity, INVALID_STACK);
 
-        for (uint64_t i = 0; i < desc.count; ++i) {
-            callstacksPool.Add() = desc.callstack[desc.count - i - 1];
+    const size_t mask = capacity - 1;
+    for (uint32 id = 0; id < (uint32)stackHashes.size(); ++id) {
+        size_t slot = (size_t)stackHashes[id] & mask;
+        while (stackTable[slot] != INVALID_STACK)
+            slot = (slot + 1) & mask;
+        stackTable[slot] = id;
+    }
+}
+
+uint32 CallstackCollector::InternStack (const CallstackDesc & desc) {
+    const uint64 hash = HashCallstack(desc);
+    const size_t mask = stackTable.size() - 1;
+
+    size_t slot = (size_t)hash & mask;
+    for (uint32 id = stackTable[slot]; id != INVALID_STACK; id = stackTable[slot]) {
+        if (stackHashes[id] == hash) {
+            const uint64 * frames = &stackFrames[stackOffsets[id]];
+            if (frames[0] == desc.count) {
+                uint64_t i = 0;
+                while (i < desc.count && frames[1 + i] == desc.callstack[desc.count - i - 1])
+                    ++i;
+
+                if (i == desc.count)
+                    return id;
+            }
         }
+
+        slot = (slot + 1) & mask;
     }
+
+    uint32 id = (uint32)stackHashes.size();
+    stackHashes.push_back(hash);
+    stackOffsets.push_back((uint32)stackFrames.size());
+
+    stackFrames.push_back(desc.count);
+    for (uint64_t i = 0; i < desc.count; ++i) {
+        stackFrames.push_back(desc.callstack[desc.count - i - 1]);
+    }
+
+    stackTable[slot] = id;
+
+    if (stackHashes.size() * 2 > stackTable.size())
+        RehashStacks(stackTable.size() * 2);
+
+    return id;
+}
+
+void CallstackCollector::Add (const CallstackDesc & desc) {
+    CallstackSample & sample = samplesPool.Add();
+    sample.threadID = desc.threadID;
+    sample.timestamp = desc.timestamp;
+    sample.stackID = InternStack(desc);
 }
 
 void CallstackCollector::Clear () {
-    callstacksPool.Clear(false);
+    samplesPool.Clear(false);
+
+    stackFrames.clear();
+    stackOffsets.clear();
+    stackHashes.clear();
+    RehashStacks(1024);
 }
 
 bool CallstackCollector::SerializeSymbols (OutputDataStream & stream) {
     typedef std::unordered_set<uint64> SymbolSet;
     SymbolSet symbolSet;
 
-    for (CallstacksPool::const_iterator it = callstacksPool.begin(); it != callstacksPool.end();) {
-        CallstacksPool::const_iterator startIt = it;
-        MT_UNUSED(startIt);
-
-        uint64_t threadID = *it;
-        MT_UNUSED(threadID);
-        ++it; //Skip ThreadID
-        uint64_t timestamp = *it;
-        MT_UNUSED(timestamp);
-        ++it; //Skip Timestamp
-        uint64_t count = *it;
-        count = (count & 0xFF);
-        ++it; //Skip Count
-
-        bool isBadAddrFound = false;
+    // Every unique stack is visited once, no matter how many samples refer to it
+    for (size_t id = 0; id < stackOffsets.size(); ++id) {
+        const uint64 * frames = &stackFrames[stackOffsets[id]];
+        uint64_t count = frames[0];
 
         for (uint64_t i = 0; i < count; ++i) {
-            uint64_t address = *it;
-            ++it;
+            uint64_t address = frames[1 + i];
 
-            if (address == 0) {
-                isBadAddrFound = true;
-            }
+            if (address == 0)
+                break;
 
-            if (!isBadAddrFound) {
-                symbolSet.insert(address);
-            }
+            symbolSet.insert(address);
         }
     }
 
-    SymbolEngine * symEngine = Core::Get().symbolEngine;
+    std::vector<uint64> addresses(symbolSet.begin(), symbolSet.end());
 
     std::vector<const Symbol *> symbols;
-    symbols.reserve(symbolSet.size());
-
-    std::stringstream msg;
-
-    size_t callstacksCount = symbolSet.size();
-    size_t callstackIndex = 0;
-
-    for (auto it = symbolSet.begin(); it != symbolSet.end(); ++it) {
-        callstackIndex++;
-        msg.str("");
-
-        uint64_t address = *it;
-        if (const Symbol* symbol = symEngine->GetSymbol(address)) {
-            symbols.push_back(symbol);
-        }
-
-        msg << "Resolving callstack " << (uint32)callstackIndex << " of " << (uint32)(callstacksCount + 1) << std::endl;
-
-        Core::Get().DumpProgress(msg.str().c_str());
+    if (Core::Get().isSymbolResolutionDeferred) {
+        Core::Get().symbolEngine->RegisterModules(addresses);
+    }
+    else {
+        Core::Get().symbolEngine->GetSymbols(addresses, symbols);
     }
 
     stream << symbols;
@@ -104,10 +126,19 @@ bool CallstackCollector::SerializeSymbols (OutputDataStream & stream) {
 }
 
 bool CallstackCollector::SerializeCallstacks (OutputDataStream & stream) {
-    stream << callstacksPool;
+    // {StackCount, {Count, Callstack[Count]}[StackCount], SampleCount, {ThreadID, Timestamp, StackID}[SampleCount]}
+    stream << (uint32)stackOffsets.size();
+    for (uint64 value : stackFrames) {
+        stream << value;
+    }
+
+    stream << (uint32)samplesPool.Size();
+    samplesPool.ForEach([&stream](const CallstackSample & sample) {
+        stream << sample.threadID << sample.timestamp << sample.stackID;
+    });
 
-    if (!callstacksPool.IsEmpty()) {
-        callstacksPool.Clear(false);
+    if (!samplesPool.IsEmpty()) {
+        Clear();
         return true;
     }
 
@@ -115,7 +146,7 @@ bool CallstackCollector::SerializeCallstacks (OutputDataStream & stream) {
 }
 
 bool CallstackCollector::IsEmpty () const {
-    return callstacksPool.IsEmpty();
+    return samplesPool.IsEmpty();
 }
 
 } // Brofiler
@@ -5,6 +5,8 @@
 #include "MemoryPool.h"
 #include "Serialization.h"
 
+#include <vector>
+
 namespace Brofiler {
 
 ////////////////////////////////////////////////////////////
@@ -38,6 +40,8 @@ struct CallstackDesc {
 
 class CallstackCollector {
 public:
+    CallstackCollector ();
+
     void Add (const CallstackDesc& desc);
     void Clear ();
 
@@ -48,9 +52,28 @@ public:
 
 private:
 
-    // Packed callstack list: {ThreadID, Timestamp, Count, Callstack[Count]}
-    typedef MemoryPool<uint64, 1024 * 32> CallstacksPool;
-    CallstacksPool callstacksPool;
+    struct CallstackSample {
+        uint64_t threadID;
+        uint64_t timestamp;
+        uint32_t stackID;
+    };
+
+    // Samples only refer to interned stacks
+    typedef MemoryPool<CallstackSample, 1024 * 4> SamplesPool;
+    SamplesPool samplesPool;
+
+    // Unique stacks, packed: {Count, Callstack[Count]}, outermost frame first
+    std::vector<uint64> stackFrames;
+    std::vector<uint32> stackOffsets;
+    std::vector<uint64> stackHashes;
+
+    // Open addressing table of stack ids (INVALID_STACK marks empty slots), load factor is kept below 1/2
+    std::vector<uint32> stackTable;
+
+    enum : uint32 { INVALID_STACK = 0xFFFFFFFF };
+
+    uint32 InternStack (const CallstackDesc & desc);
+    void RehashStacks (size_t capacity);
 };
 
 } // Brofiler
@@ -3,14 +3,22 @@
 #include "Event.h"
 #include "ProfilerServer.h"
 #include "EventDescriptionBoard.h"
+#include "CounterDescriptionBoard.h"
 
 #include "Platform/SchedulerTrace.h"
 #include "Platform/SamplingProfiler.h"
 #include "Platform/SymbolEngine.h"
 
+#include <algorithm>
+
+#if defined(__linux__)
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
 
 extern "C" Brofiler::EventData * NextEvent () {
-    if (Brofiler::EventStorage * storage = Brofiler::Core::storage) {
+    if (Brofiler::EventStorage * storage = Brofiler::Core::GetStorage()) {
         return &storage->NextEvent();
     }
     return nullptr;
@@ -19,6 +27,23 @@ extern "C" Brofiler::EventData * NextEvent () {
 
 namespace Brofiler {
 
+////////////////////////////////////////////////////////////
+//
+//    ThreadDescription
+//
+/////
+
+uint64_t ThreadDescription::GetCurrentSystemThreadId () {
+#if MT_PLATFORM_WINDOWS
+    return GetCurrentThreadId();
+#elif defined(__linux__)
+    return (uint64_t)syscall(SYS_gettid);
+#else
+    return MT::ThreadId::Self().AsUInt64();
+#endif
+}
+
+
 ////////////////////////////////////////////////////////////
 //
 //    Core
@@ -26,6 +51,9 @@ namespace Brofiler {
 /////
 
 thread_local EventStorage * Core::storage = nullptr;
+thread_local ThreadEntry * Core::threadEntry = nullptr;
+thread_local uint32 Core::storageEpoch = 0;
+MT::Atomic32Base<uint32> Core::captureEpoch = { 0 };
 Core Core::notThreadSafeInstance;
 
 Core::Core ()
@@ -33,15 +61,13 @@ Core::Core ()
     , symbolEngine(SymbolEngine::Get())
     , schedulerTrace(SchedulerTrace::Get())
 {
+    EventDescriptionBoard::Get().RegisterStaticDescriptions();
 }
 
 Core::~Core () {
     MT::ScopedGuard guard(lock);
 
-    for (ThreadList::iterator it = threads.begin(); it != threads.end(); ++it) {
-        (*it)->~ThreadEntry();
-        MT::Memory::Free((*it));
-    }
+    // Entries are released by the registry
     threads.clear();
 
     for (FiberList::iterator it = fibers.begin(); it != fibers.end(); ++it) {
@@ -63,25 +89,33 @@ void Core::DumpProgress (const char * message) {
 void Core::DumpEvents (const EventStorage & entry, const EventTime & timeSlice, ScopeData & scope) {
     if (!entry.eventBuffer.IsEmpty()) {
         const EventData* rootEvent = nullptr;
+        uint32_t bufferIndex = 0;
+
+        ArgumentBuffer::const_iterator argumentIt = entry.argumentBuffer.begin();
+        const ArgumentBuffer::const_iterator argumentEnd = entry.argumentBuffer.end();
 
         entry.eventBuffer.ForEach([&](const EventData & data) {
             if (data.finish >= data.start && data.start >= timeSlice.start && timeSlice.finish >= data.finish) {
                 if (!rootEvent) {
                     rootEvent = &data;
-                    scope.InitRootEvent(*rootEvent);
+                    scope.InitRootEvent(*rootEvent, bufferIndex);
                 }
                 else if (rootEvent->finish < data.finish) {
+                    scope.AttachArguments(argumentIt, argumentEnd);
                     scope.Send();
 
                     rootEvent = &data;
-                    scope.InitRootEvent(*rootEvent);
+                    scope.InitRootEvent(*rootEvent, bufferIndex);
                 }
                 else {
-                    scope.AddEvent(data);
+                    scope.AddEvent(data, bufferIndex);
                 }
             }
+
+            ++bufferIndex;
         });
 
+        scope.AttachArguments(argumentIt, argumentEnd);
         scope.Send();
     }
 }
@@ -116,6 +150,124 @@ void Core::DumpFiber (const FiberEntry & entry, const EventTime & timeSlice, Sco
     BRO_ASSERT(entry.storage.synchronizationBuffer.IsEmpty(), "Native thread events in fiber?");
 }
 
+static uint32_t CollectCounters (const EventStorage & storage, const EventTime & timeSlice) {
+    uint32_t count = 0;
+
+    storage.counterBuffer.ForEach([&](const CounterData & data) {
+        if (data.timestamp >= timeSlice.start && timeSlice.finish >= data.timestamp) {
+            if (data.description->index == CounterDescription::INVALID_INDEX) {
+                CounterDescriptionBoard::Get().RegisterDescription(data.description);
+            }
+            ++count;
+        }
+    });
+
+    return count;
+}
+
+static void SerializeCounters (OutputDataStream & stream, const EventStorage & storage, const EventTime & timeSlice, uint32_t count) {
+    stream << count;
+
+    storage.counterBuffer.ForEach([&](const CounterData & data) {
+        if (data.timestamp >= timeSlice.start && timeSlice.finish >= data.timestamp) {
+            stream << data;
+        }
+    });
+}
+
+void Core::DumpCounters (const EventTime & timeSlice, uint32_t boardNumber) {
+    // First pass registers descriptions, so the board is complete before it is serialized
+    std::vector<uint32_t> threadCounts(threads.size());
+    std::vector<uint32_t> fiberCounts(fibers.size());
+    uint32_t trackCount = 0;
+
+    for (size_t i = 0; i < threads.size(); ++i) {
+        threadCounts[i] = CollectCounters(threads[i]->storage, timeSlice);
+        trackCount += threadCounts[i] > 0 ? 1 : 0;
+    }
+
+    for (size_t i = 0; i < fibers.size(); ++i) {
+        fiberCounts[i] = CollectCounters(fibers[i]->storage, timeSlice);
+        trackCount += fiberCounts[i] > 0 ? 1 : 0;
+    }
+
+    if (trackCount == 0)
+        return;
+
+    OutputDataStream countersStream;
+    countersStream << boardNumber;
+    countersStream << CounterDescriptionBoard::Get();
+    countersStream << trackCount;
+
+    for (size_t i = 0; i < threads.size(); ++i) {
+        if (threadCounts[i] > 0) {
+            countersStream << (int32)i << (int32)-1;
+            SerializeCounters(countersStream, threads[i]->storage, timeSlice, threadCounts[i]);
+        }
+    }
+
+    for (size_t i = 0; i < fibers.size(); ++i) {
+        if (fiberCounts[i] > 0) {
+            countersStream << (int32)-1 << (int32)i;
+            SerializeCounters(countersStream, fibers[i]->storage, timeSlice, fiberCounts[i]);
+        }
+    }
+
+    Server::Get().Send(DataResponse::Counters, countersStream);
+}
+
+void Core::DumpLocks (const EventTime & timeSlice, uint32_t boardNumber) {
+    OutputDataStream stream;
+    stream << boardNumber;
+
+    if (lockCollector.Serialize(stream, threads, fibers, timeSlice))
+        Server::Get().Send(DataResponse::Locks, stream);
+}
+
+void Core::DumpCoreTimeline (const EventTime & timeSlice, uint32_t boardNumber) {
+    if (!schedulerTrace)
+        return;
+
+    OutputDataStream stream;
+    stream << boardNumber;
+    coreTimelineCollector.Serialize(stream, threads, timeSlice);
+    Server::Get().Send(DataResponse::CoreTimeline, stream);
+}
+
+void Core::DumpWaitChains (uint32_t boardNumber, uint32_t mainThreadIndex) {
+    if (!schedulerTrace)
+        return;
+
+    OutputDataStream stream;
+    stream << boardNumber;
+    waitChainCollector.Serialize(stream, threads, frames, mainThreadIndex);
+    Server::Get().Send(DataResponse::WaitChains, stream);
+}
+
+void Core::DumpAllocations (uint32_t boardNumber) {
+    std::vector<const EventStorage *> storages;
+
+    for (const ThreadEntry * entry : threads) {
+        if (!entry->storage.allocationBuffer.IsEmpty())
+            storages.push_back(&entry->storage);
+    }
+
+    for (const FiberEntry * entry : fibers) {
+        if (!entry->storage.allocationBuffer.IsEmpty())
+            storages.push_back(&entry->storage);
+    }
+
+    if (storages.empty())
+        return;
+
+    DumpProgress("Serializing Allocations");
+
+    OutputDataStream stream;
+    stream << boardNumber;
+    allocationCollector.Serialize(stream, storages, frames);
+    Server::Get().Send(DataResponse::Allocations, stream);
+}
+
 void Core::DumpFrames () {
     if (frames.empty() || threads.empty())
         return;
@@ -137,6 +289,8 @@ void Core::DumpFrames () {
     timeSlice.start = frames.front().start;
     timeSlice.finish = frames.back().finish;
 
+    RegisterPendingDescriptions(timeSlice);
+
     OutputDataStream boardStream;
 
     static uint32_t boardNumber = 0;
@@ -147,6 +301,7 @@ void Core::DumpFrames () {
     boardStream << fibers;
     boardStream << mainThreadIndex;
     boardStream << EventDescriptionBoard::Get();
+    EventDescriptionBoard::Get().SerializeSampleRatios(boardStream);
     Server::Get().Send(DataResponse::FrameDescriptionBoard, boardStream);
 
     ScopeData threadScope;
@@ -166,22 +321,32 @@ void Core::DumpFrames () {
         DumpFiber(*fibers[i], timeSlice, fiberScope);
     }
 
-    frames.clear();
-    CleanupThreadsAndFibers();
+    DumpCounters(timeSlice, boardNumber);
+    DumpLocks(timeSlice, boardNumber);
+    DumpCoreTimeline(timeSlice, boardNumber);
+    DumpWaitChains(boardNumber, mainThreadIndex);
+    DumpAllocations(boardNumber);
 
     {
         DumpProgress("Serializing SysCalls");
-        OutputDataStream callstacksStream;
-        callstacksStream << boardNumber;
-        syscallCollector.Serialize(callstacksStream);
-        Server::Get().Send(DataResponse::SyscallPack, callstacksStream);
+        OutputDataStream syscallsStream;
+        syscallsStream << boardNumber;
+        syscallCollector.Serialize(syscallsStream, threads, frames);
+        Server::Get().Send(DataResponse::SyscallPack, syscallsStream);
     }
 
+    frames.clear();
+    CleanupThreadsAndFibers();
+
     if (!callstackCollector.IsEmpty()) {
         DumpProgress("Resolving callstacks");
         OutputDataStream symbolsStream;
         symbolsStream << boardNumber;
         callstackCollector.SerializeSymbols(symbolsStream);
+
+        if (isSymbolResolutionDeferred)
+            DumpModules();
+
         Server::Get().Send(DataResponse::SymbolPack, symbolsStream);
 
         DumpProgress("Serializing callstacks");
@@ -199,24 +364,27 @@ void Core::DumpSamplingData () {
         OutputDataStream stream;
         samplingProfiler->Serialize(stream);
 
+        if (isSymbolResolutionDeferred)
+            DumpModules();
+
         DumpProgress("Sending Message With Sampling Data...");
         Server::Get().Send(DataResponse::SamplingFrame, stream);
     }
 }
 
+void Core::DumpModules () {
+    // Packet: {Modules: {Base, Size, Path, BuildId}[]}, it is sent before the data which refers to the addresses.
+    // Only the modules of the current capture are sent, the engine keeps every module it has ever looked up.
+    OutputDataStream stream;
+    stream << symbolEngine->GetReferencedModules();
+    Server::Get().Send(DataResponse::ModuleTable, stream);
+}
+
 void Core::CleanupThreadsAndFibers () {
     MT::ScopedGuard guard(lock);
 
-    for (ThreadList::iterator it = threads.begin(); it != threads.end();) {
-        if (!(*it)->isAlive) {
-            (*it)->~ThreadEntry();
-            MT::Memory::Free(*it);
-            it = threads.erase(it);
-        }
-        else {
-            ++it;
-        }
-    }
+    threadRegistry.Collect();
+    threadRegistry.Snapshot(threads);
 
     /*
     for (FiberList::iterator it = fibers.begin(); it != fibers.end(); ++it)
@@ -228,9 +396,40 @@ void Core::CleanupThreadsAndFibers () {
     */
 }
 
+// The section walk on startup misses descriptions of other images (the core built as a DLL or a shared object)
+// and entries discarded by the linker, they are registered here before the board is sent
+void Core::RegisterPendingDescriptions (const EventTime & timeSlice) {
+    EventDescriptionBoard & board = EventDescriptionBoard::Get();
+
+    auto registerDescription = [&board, &timeSlice](const EventData & data) {
+        if (data.description->index == EventDescription::INVALID_INDEX && data.start >= timeSlice.start && timeSlice.finish >= data.finish) {
+            board.RegisterDescription(const_cast<EventDescription *>(data.description));
+        }
+    };
+
+    for (ThreadList::iterator it = threads.begin(); it != threads.end(); ++it) {
+        (*it)->storage.eventBuffer.ForEach(registerDescription);
+    }
+
+    for (FiberList::iterator it = fibers.begin(); it != fibers.end(); ++it) {
+        (*it)->storage.eventBuffer.ForEach(registerDescription);
+    }
+}
+
 void Core::Update () {
     MT::ScopedGuard guard(lock);
 
+    // Unregistered threads are released right away unless a capture still needs their data
+    if (isActive) {
+        RefreshThreads();
+
+        if (schedulerTrace)
+            schedulerTrace->AttachThreads(threads);
+    }
+    else {
+        CleanupThreadsAndFibers();
+    }
+
     if (isActive) {
         if (!frames.empty())
             frames.back().Stop();
@@ -256,7 +455,13 @@ void Core::UpdateEvents () {
 }
 
 void Core::ReportSysCall (const SysCallDesc& desc) {
-    syscallCollector.Add(desc);
+    if (!schedulerTrace) {
+        return;
+    }
+
+    if (ThreadEntry* entry = schedulerTrace->FindActiveThread(desc.threadId)) {
+        syscallCollector.Add(entry->storage.sysCallBuffer, desc);
+    }
 }
 
 SwitchContextResult Core::ReportSwitchContext (const SwitchContextDesc & desc) {
@@ -269,42 +474,37 @@ SwitchContextResult Core::ReportSwitchContext (const SwitchContextDesc & desc) {
 
     int state = 0;
 
+    ThreadEntry* newEntry = schedulerTrace->FindActiveThread(desc.newThreadId);
+    coreTimelineCollector.Add(desc, newEntry != nullptr);
+
     // finalize work interval
-    auto oldThreadIt = schedulerTrace->activeThreadsIDs.find(desc.oldThreadId);
-    if (oldThreadIt != schedulerTrace->activeThreadsIDs.end()) {
-        ThreadEntry* entry = oldThreadIt->second;
-        if (entry) {
-            if (SyncData* time = entry->storage.synchronizationBuffer.Back()) {
-                time->finish = desc.timestamp;
-                time->reason = desc.reason;
-                time->newThreadId = desc.newThreadId;
-            }
-            state |= THREAD_DISABLED_BIT;
+    if (ThreadEntry* entry = schedulerTrace->FindActiveThread(desc.oldThreadId)) {
+        if (SyncData* time = entry->storage.synchronizationBuffer.Back()) {
+            time->finish = desc.timestamp;
+            time->reason = desc.reason;
+            time->newThreadId = desc.newThreadId;
+        }
+        state |= THREAD_DISABLED_BIT;
 
-            // early exit
-            if ((state & THREAD_DISABLED_BIT) != 0 && (state & THREAD_ENABLED_BIT) != 0) {
-                return SCR_INSIDEPROCESS;
-            }
+        // early exit
+        if ((state & THREAD_DISABLED_BIT) != 0 && (state & THREAD_ENABLED_BIT) != 0) {
+            return SCR_INSIDEPROCESS;
         }
     }
 
     // finalize work interval
-    auto newThreadIt = schedulerTrace->activeThreadsIDs.find(desc.newThreadId);
-    if (newThreadIt != schedulerTrace->activeThreadsIDs.end()) {
-        ThreadEntry* entry = newThreadIt->second;
-        if (entry) {
-            SyncData& time = entry->storage.synchronizationBuffer.Add();
-            time.start = desc.timestamp;
-            time.finish = time.start;
-            time.core = desc.cpuId;
-            time.newThreadId = 0;
-
-            state |= THREAD_ENABLED_BIT;
-
-            // early exit
-            if ((state & THREAD_DISABLED_BIT) != 0 && (state & THREAD_ENABLED_BIT) != 0) {
-                return SCR_INSIDEPROCESS;
-            }
+    if (ThreadEntry* entry = newEntry) {
+        SyncData& time = entry->storage.synchronizationBuffer.Add();
+        time.start = desc.timestamp;
+        time.finish = time.start;
+        time.core = desc.cpuId;
+        time.newThreadId = 0;
+
+        state |= THREAD_ENABLED_BIT;
+
+        // early exit
+        if ((state & THREAD_DISABLED_BIT) != 0 && (state & THREAD_ENABLED_BIT) != 0) {
+            return SCR_INSIDEPROCESS;
         }
     }
 
@@ -319,14 +519,23 @@ SwitchContextResult Core::ReportSwitchContext (const SwitchContextDesc & desc) {
     return SCR_THREADENABLED;
 }
 
+void Core::ReportWakeup (const WakeupDesc & desc) {
+    if (!schedulerTrace) {
+        return;
+    }
+
+    if (schedulerTrace->FindActiveThread(desc.wokenThreadId)) {
+        waitChainCollector.Add(desc);
+    }
+}
+
 
 bool Core::ReportStackWalk (const CallstackDesc & desc) {
     if (!schedulerTrace) {
         return false;
     }
 
-    auto it = schedulerTrace->activeThreadsIDs.find(desc.threadID);
-    if (it == schedulerTrace->activeThreadsIDs.end()) {
+    if (!schedulerTrace->FindActiveThread(desc.threadID)) {
         return false;
     }
 
@@ -334,33 +543,39 @@ bool Core::ReportStackWalk (const CallstackDesc & desc) {
     return true;
 }
 
-void Core::StartSampling () {
-    samplingProfiler->StartSampling(threads);
+void Core::StartSampling (const SamplingSettings & settings) {
+    SamplingSettings validSettings = settings;
+    validSettings.Validate();
+    samplingProfiler->StartSampling(threads, validSettings);
 }
 
 void Core::Activate (bool active) {
     if (isActive != active) {
         isActive = active;
 
-        for (auto it = threads.begin(); it != threads.end(); ++it) {
-            ThreadEntry * entry = *it;
-            entry->Activate(active);
-        }
+        RefreshThreads();
 
-        /*
-        for(auto it = fibers.begin(); it != fibers.end(); ++it)
-        {
-        FiberEntry* entry = *it;
-        entry->Activate(active);
+        // Storages are reset before the epoch moves: threads bind them with an acquire load of the epoch
+        if (active) {
+            for (ThreadEntry * entry : threads) {
+                entry->storage.Clear(true);
+            }
+
+            EventDescriptionBoard::Get().StartSampleRatioLog(GetHighPrecisionTime());
+            symbolEngine->ResetReferencedModules();
         }
-        */
+
+        captureEpoch.IncFetch();
 
         if (active) {
+            coreTimelineCollector.Clear();
+            waitChainCollector.Clear();
+
             CaptureStatus::Type status = schedulerTrace->Start(SchedulerTrace::ALL, threads, true);
 
             // Let's retry with more narrow setup
             if (status != CaptureStatus::OK)
-                status = schedulerTrace->Start(SchedulerTrace::SWITCH_CONTEXTS, threads, true);
+                status = schedulerTrace->Start(SchedulerTrace::SWITCH_CONTEXTS | SchedulerTrace::WAKEUPS, threads, true);
 
             SendHandshakeResponse(status);
         }
@@ -395,48 +610,46 @@ void Core::SendHandshakeResponse (CaptureStatus::Type status) {
 
 
 bool Core::IsRegistredThread (MT::ThreadId id) {
-    MT::ScopedGuard guard(lock);
-    for (ThreadList::iterator it = threads.begin(); it != threads.end(); ++it) {
-        ThreadEntry* entry = *it;
-        if (entry->description.threadID.IsEqual(id)) {
-            return true;
-        }
-    }
-    return false;
+    return threadRegistry.Contains(id.AsUInt64());
 }
 
 
 
 bool Core::RegisterThread (const ThreadDescription & description, EventStorage ** slot) {
-    MT::ScopedGuard guard(lock);
-    ThreadEntry* entry = new (MT::Memory::Alloc(sizeof(ThreadEntry), BRO_CACHE_LINE_SIZE)) ThreadEntry(description, slot);
-    threads.push_back(entry);
+    ThreadEntry* entry = threadRegistry.Add(description, slot);
+    if (entry == nullptr)
+        return false;
 
-    if (isActive && slot != nullptr && *slot != nullptr)
-        *slot = &entry->storage;
+    // Registration of the calling thread: the storage is bound by its next event
+    if (slot == &storage) {
+        threadEntry = entry;
+        storageEpoch = UNBOUND_EPOCH;
+    }
+
+    // Switches and syscalls of the thread are attributed from now on, not from the next update
+    if (schedulerTrace && (captureEpoch.Load() & 1) != 0)
+        schedulerTrace->AttachThreads(ThreadList(1, entry));
 
     return true;
 }
 
 bool Core::UnRegisterThread (MT::ThreadId threadID) {
-    MT::ScopedGuard guard(lock);
-    for (ThreadList::iterator it = threads.begin(); it != threads.end(); ++it) {
-        ThreadEntry* entry = *it;
-        if (entry->description.threadID.IsEqual(threadID) && entry->isAlive) {
-            if (!isActive) {
-                entry->~ThreadEntry();
-                MT::Memory::Free(entry);
-                threads.erase(it);
-                return true;
-            }
-            else {
-                entry->isAlive = false;
-                return true;
-            }
-        }
+    // Read before the entry is marked as dead: it may be released right after that
+    if (threadEntry != nullptr && threadEntry->description.threadID.IsEqual(threadID)) {
+        threadEntry = nullptr;
+        storageEpoch = UNBOUND_EPOCH;
     }
 
-    return false;
+    // The entry is released by the next update, the dump may be reading it right now
+    return threadRegistry.Remove(threadID.AsUInt64());
+}
+
+void Core::BindStorage () {
+    // Acquire: storages are reset by Activate before the epoch moves
+    uint32 epoch = captureEpoch.Load();
+
+    storage = (threadEntry != nullptr && (epoch & 1) != 0) ? &threadEntry->storage : nullptr;
+    storageEpoch = epoch;
 }
 
 bool Core::RegisterFiber (const FiberDescription & description, EventStorage ** slot) {
@@ -452,6 +665,10 @@ const std::vector<ThreadEntry *> & Core::GetThreads () const {
     return threads;
 }
 
+void Core::RefreshThreads () {
+    threadRegistry.Snapshot(threads);
+}
+
 
 ////////////////////////////////////////////////////////////
 //
@@ -464,7 +681,24 @@ OutputDataStream & operator<< (OutputDataStream & stream, const ScopeHeader & he
 }
 
 OutputDataStream & operator<< (OutputDataStream & stream, const ScopeData & ob) {
-    return stream << ob.header << ob.categories << ob.events;
+    return stream << ob.header << ob.categories << ob.events << ob.arguments;
+}
+
+OutputDataStream & operator<< (OutputDataStream & stream, const CounterData & ob) {
+    return stream << ob.timestamp << ob.description->index << ob.value;
+}
+
+OutputDataStream & operator<< (OutputDataStream & stream, const EventArgument & ob) {
+    const ArgumentData & data = *ob.data;
+    stream << ob.eventIndex << data.name << (uint8_t)data.type;
+
+    switch (data.type) {
+        case ArgumentData::Integer: return stream << (int64)data.asInteger;
+        case ArgumentData::Float:   return stream << data.asFloat;
+        case ArgumentData::String:  return stream << data.asString;
+    }
+
+    return stream;
 }
 
 OutputDataStream & operator<< (OutputDataStream & stream, const ThreadDescription & description) {
@@ -490,8 +724,8 @@ OutputDataStream & operator<< (OutputDataStream & stream, const FiberEntry * ent
 //
 /////
 
-EventStorage::EventStorage() : isSampling(0), isFiberStorage(false) {
-
+EventStorage::EventStorage() : isSampling(0), isFiberStorage(false), scopeDepth(0), eventDepth(0), scopeLogCount(0) {
+    memset(sampleCounters, 0, sizeof(sampleCounters));
 }
 
 
@@ -517,18 +751,6 @@ static bool IsSleepOnlyScope (const ScopeData & scope) {
     return true;
 }
 
-void ThreadEntry::Activate (bool isActive) {
-    if (!isAlive)
-        return;
-
-    if (isActive)
-        storage.Clear(true);
-
-    if (threadTLS != nullptr) {
-        *threadTLS = isActive ? &storage : nullptr;
-    }
-}
-
 
 
 void ScopeData::Send () {
@@ -543,9 +765,32 @@ void ScopeData::Send () {
     Clear();
 }
 
+void ScopeData::AttachArguments (ArgumentBuffer::const_iterator & it, const ArgumentBuffer::const_iterator & end) {
+    if (events.empty())
+        return;
+
+    // Arguments come in the order of the scopes: the ones before the root belong to events which weren't dumped
+    for (; it != end; ++it) {
+        const ArgumentData & argument = *it;
+
+        if (argument.eventIndex < bufferIndices.front())
+            continue;
+
+        if (argument.eventIndex > bufferIndices.back())
+            break;
+
+        auto event = std::lower_bound(bufferIndices.begin(), bufferIndices.end(), argument.eventIndex);
+        if (*event == argument.eventIndex) {
+            arguments.push_back(EventArgument{ (uint32_t)(event - bufferIndices.begin()), &argument });
+        }
+    }
+}
+
 void ScopeData::Clear() {
     events.clear();
     categories.clear();
+    arguments.clear();
+    bufferIndices.clear();
 }
 
 
@@ -568,7 +813,9 @@ BRO_API bool IsActive() {
 }
 
 BRO_API EventStorage ** GetEventStorageSlotForCurrentThread() {
-    return &Core::Get().storage;
+    // Fiber switches read and replace the slot: it has to be bound for the current capture first
+    Core::GetStorage();
+    return &Core::storage;
 }
 
 BRO_API bool IsFiberStorage (EventStorage* fiberStorage) {
@@ -576,7 +823,7 @@ BRO_API bool IsFiberStorage (EventStorage* fiberStorage) {
 }
 
 BRO_API bool RegisterThread(const char* name) {
-    return Core::Get().RegisterThread(ThreadDescription(name, MT::ThreadId::Self(), false), &Core::storage);
+    return Core::Get().RegisterThread(ThreadDescription(name, MT::ThreadId::Self(), ThreadDescription::GetCurrentSystemThreadId(), false), &Core::storage);
 }
 
 BRO_API bool UnRegisterThread() {
@@ -6,7 +6,14 @@
 #include "Serialization.h"
 #include "CallstackCollector.h"
 #include "SysCallCollector.h"
-
+#include "CoreTimelineCollector.h"
+#include "WaitChainCollector.h"
+#include "AllocationCollector.h"
+#include "LockCollector.h"
+#include "ThreadRegistry.h"
+
+#include <atomic>
+#include <cstring>
 #include <map>
 
 namespace Brofiler {
@@ -41,6 +48,93 @@ using SynchronizationBuffer = MemoryPool<SyncData, 1024>;
 using FiberSyncBuffer       = MemoryPool<FiberSyncData, 1024>;
 
 
+////////////////////////////////////////////////////////////
+//
+//    SamplingSettings
+//
+/////
+
+struct SamplingSettings {
+    enum : uint32_t {
+        DEFAULT_INTERVAL = 300,
+        MIN_INTERVAL     = 50,      // Shorter intervals keep the sampled threads busy in the sampler
+        MAX_INTERVAL     = 1000000,
+    };
+
+    uint32_t intervalMicroSeconds = DEFAULT_INTERVAL;
+    uint32_t maxDepth             = 0; // Frames kept per sample (innermost first), 0 - unlimited
+    uint32_t sampleBudget         = 0; // Samples kept per capture, 0 - unlimited
+
+    // Zero interval (perf sample period, timer_create and the Windows due time can't take it) falls back to the default, the rest is clamped
+    void Validate () {
+        if (intervalMicroSeconds == 0)
+            intervalMicroSeconds = DEFAULT_INTERVAL;
+        else if (intervalMicroSeconds < MIN_INTERVAL)
+            intervalMicroSeconds = MIN_INTERVAL;
+        else if (intervalMicroSeconds > MAX_INTERVAL)
+            intervalMicroSeconds = MAX_INTERVAL;
+    }
+};
+
+
+////////////////////////////////////////////////////////////
+//
+//    ArgumentData
+//
+/////
+
+struct ArgumentData {
+    enum Type : uint8_t {
+        Integer = 0,
+        Float   = 1,
+        String  = 2,
+    };
+
+    uint32_t     eventIndex; // Event the argument was recorded in (index into EventStorage::eventBuffer)
+    const char * name;
+    union {
+        int64_t asInteger;
+        double  asFloat;
+        char    asString[Argument::MAX_STRING_LENGTH + 1];
+    };
+    Type         type;
+};
+
+using ArgumentBuffer = MemoryPool<ArgumentData, 64>;
+
+
+////////////////////////////////////////////////////////////
+//
+//    CounterData
+//
+/////
+
+struct CounterData {
+    int64_t              timestamp;
+    CounterDescription * description;
+    double               value;
+};
+
+OutputDataStream & operator<< (OutputDataStream & stream, const CounterData & ob);
+
+using CounterBuffer = MemoryPool<CounterData, 256>;
+
+
+////////////////////////////////////////////////////////////
+//
+//    EventArgument
+//
+/////
+
+// Argument bound to the event it was recorded in (index into ScopeData::events)
+struct EventArgument {
+    uint32_t             eventIndex;
+    const ArgumentData * data;
+};
+
+OutputDataStream & operator<< (OutputDataStream & stream, const EventArgument & ob);
+
+
 ////////////////////////////////////////////////////////////
 //
 //    ScopeHeader
@@ -67,19 +161,25 @@ struct ScopeData {
     ScopeHeader            header;
     std::vector<EventData> categories;
     std::vector<EventData> events;
+    std::vector<EventArgument> arguments;
+    std::vector<uint32_t>  bufferIndices; // Index of every event of the scope in EventStorage::eventBuffer, ascending
 
-    void AddEvent (const EventData & data) {
+    void AddEvent (const EventData & data, uint32_t bufferIndex) {
         events.push_back(data);
+        bufferIndices.push_back(bufferIndex);
         if (data.description->color != Color::Null) {
             categories.push_back(data);
         }
     }
 
-    void InitRootEvent (const EventData & data) {
+    void InitRootEvent (const EventData & data, uint32_t bufferIndex) {
         header.event = data;
-        AddEvent(data);
+        AddEvent(data, bufferIndex);
     }
 
+    // Takes the arguments of the events of the scope, skips the ones of events which weren't dumped
+    void AttachArguments (ArgumentBuffer::const_iterator & it, const ArgumentBuffer::const_iterator & end);
+
     void Send();
     void Clear();
 };
@@ -98,16 +198,121 @@ struct EventStorage {
     CategoryBuffer        categoryBuffer;
     SynchronizationBuffer synchronizationBuffer;
     FiberSyncBuffer       fiberSyncBuffer;
+    ArgumentBuffer        argumentBuffer;
+    CounterBuffer         counterBuffer;
+    LockBuffer            lockBuffer;
+    AllocationBuffer      allocationBuffer;
+    SysCallBuffer         sysCallBuffer;
 
     MT::Atomic32<uint32> isSampling;
     bool                 isFiberStorage;
 
+    // Descriptions of the open events, read by the samplers to attribute callstacks to the innermost scope
+    enum : uint32_t { MAX_SCOPE_DEPTH = 64 };
+    const EventDescription * scopeStack[MAX_SCOPE_DEPTH];
+    MT::Atomic32<uint32>     scopeDepth;
+
+    // Event of every open scope (index into eventBuffer), arguments are bound to the innermost one when they are recorded.
+    // Scopes which weren't recorded (disabled or subsampled) push SKIPPED_EVENT, so their arguments are dropped.
+    enum : uint32_t { SKIPPED_EVENT = 0xFFFFFFFF };
+    uint32    eventStack[MAX_SCOPE_DEPTH];
+    uint32    eventDepth;
+    EventData skippedEvent; // Returned by Event::Start for a skipped scope, so that its Stop pops the stack
+
+    // Timestamped log of the scope changes, written by the thread only. Samplers which drain their data later
+    // (perf rings) replay it to find the scope state at the time of each sample. The writer never waits:
+    // a reader which falls SCOPE_LOG_SIZE entries behind has to resynchronize from scopeStack.
+    struct ScopeLogEntry {
+        int64_t                  timestamp;
+        const EventDescription * description;
+        uint32                   flags;
+    };
+
+    enum ScopeLogFlags : uint32 {
+        SCOPE_LEAVE    = 1 << 0,
+        SCOPE_SAMPLING = 1 << 1, // The scope is counted by isSampling
+    };
+
+    enum : uint32_t { SCOPE_LOG_SIZE = 1024 };
+    ScopeLogEntry        scopeLog[SCOPE_LOG_SIZE];
+    MT::Atomic32<uint32> scopeLogCount; // Entries written so far, wraps around
+
+    // Invocation counters of descriptions with sampleRatio > 1 (indexed by EventDescription::sampleSlot), fixed size so Start never allocates
+    uint32_t sampleCounters[EventDescription::MAX_SAMPLE_SLOTS];
+
     EventStorage ();
 
     BRO_FORCE_INLINE EventData& NextEvent () {
         return eventBuffer.Add();
     }
 
+    // Returns true for the first of every sampleRatio invocations
+    BRO_FORCE_INLINE bool NextSample (const EventDescription & description) {
+        uint32_t & counter = sampleCounters[description.sampleSlot];
+        const bool isRecorded = (counter == 0);
+
+        if (++counter >= description.sampleRatio)
+            counter = 0;
+
+        return isRecorded;
+    }
+
+    BRO_FORCE_INLINE void PushScope (const EventDescription & description) {
+        uint32 depth = scopeDepth.LoadRelaxed();
+        if (depth < MAX_SCOPE_DEPTH)
+            scopeStack[depth] = &description;
+
+        // Publish the entry before the depth: samplers may interrupt the thread at any point
+        scopeDepth.Store(depth + 1);
+    }
+
+    BRO_FORCE_INLINE void PopScope () {
+        uint32 depth = scopeDepth.LoadRelaxed();
+        if (depth > 0)
+            scopeDepth.Store(depth - 1);
+    }
+
+    BRO_FORCE_INLINE void PushEvent (uint32 eventIndex) {
+        if (eventDepth < MAX_SCOPE_DEPTH)
+            eventStack[eventDepth] = eventIndex;
+
+        ++eventDepth;
+    }
+
+    BRO_FORCE_INLINE void PopEvent () {
+        if (eventDepth > 0)
+            --eventDepth;
+    }
+
+    // SKIPPED_EVENT outside of events, inside a skipped scope and deeper than MAX_SCOPE_DEPTH
+    BRO_FORCE_INLINE uint32 GetCurrentEvent () const {
+        if (eventDepth == 0 || eventDepth > MAX_SCOPE_DEPTH)
+            return SKIPPED_EVENT;
+
+        return eventStack[eventDepth - 1];
+    }
+
+    BRO_FORCE_INLINE void LogScope (int64_t timestamp, const EventDescription & description, uint32 flags) {
+        uint32 count = scopeLogCount.LoadRelaxed();
+
+        ScopeLogEntry & entry = scopeLog[count & (SCOPE_LOG_SIZE - 1)];
+        entry.timestamp = timestamp;
+        entry.description = &description;
+        entry.flags = flags;
+
+        // Publish the entry before the count
+        scopeLogCount.Store(count + 1);
+    }
+
+    // Scopes deeper than MAX_SCOPE_DEPTH are attributed to the deepest tracked one
+    BRO_FORCE_INLINE const EventDescription * GetCurrentScope () const {
+        uint32 depth = scopeDepth.Load();
+        if (depth == 0)
+            return nullptr;
+
+        return scopeStack[(depth < MAX_SCOPE_DEPTH ? depth : MAX_SCOPE_DEPTH) - 1];
+    }
+
     BRO_FORCE_INLINE void RegisterCategory (const EventData & eventData) {
         categoryBuffer.Add() = &eventData;
     }
@@ -118,10 +323,21 @@ struct EventStorage {
         categoryBuffer.Clear(preserveContent);
         synchronizationBuffer.Clear(preserveContent);
         fiberSyncBuffer.Clear(preserveContent);
+        argumentBuffer.Clear(preserveContent);
+        counterBuffer.Clear(preserveContent);
+        lockBuffer.Clear(preserveContent);
+        allocationBuffer.Clear(preserveContent);
+        sysCallBuffer.Clear(preserveContent);
+        scopeDepth.Store(0);
+        eventDepth = 0;
     }
 
+    // Prepares the storage of a dead thread for the next one, the pools keep their chunks
     void Reset () {
         Clear(true);
+        isSampling.Store(0);
+        isFiberStorage = false;
+        memset(sampleCounters, 0, sizeof(sampleCounters));
     }
 };
 
@@ -135,14 +351,18 @@ struct EventStorage {
 struct ThreadDescription {
     const char * name;
     MT::ThreadId threadID;
+    uint64_t     systemThreadId; // Kernel thread id (GetCurrentThreadId / gettid), as reported by system tracers
     bool         fromOtherProcess;
 
-    ThreadDescription (const char * threadName, const MT::ThreadId & id, bool fromOtherProcess)
+    ThreadDescription (const char * threadName, const MT::ThreadId & id, uint64_t systemId, bool fromOtherProcess)
         : name(threadName)
         , threadID(id)
+        , systemThreadId(systemId)
         , fromOtherProcess(fromOtherProcess)
     {
     }
+
+    static uint64_t GetCurrentSystemThreadId ();
 };
 
 
@@ -172,16 +392,39 @@ struct ThreadEntry {
     EventStorage      storage;
     EventStorage **   threadTLS;
 
-    bool isAlive;
+    // Cleared by the thread itself on unregistration, read by the dump without a lock
+    std::atomic<bool> isAlive;
+
+    // The caller's name may go away with the thread, while the entry is still dumped and recycled
+    enum { MAX_NAME_LENGTH = 128 };
+    char name[MAX_NAME_LENGTH];
 
     ThreadEntry (const ThreadDescription & desc, EventStorage ** tls)
         : description(desc)
         , threadTLS(tls)
         , isAlive(true)
     {
+        CopyName();
     }
 
-    void Activate(bool isActive);
+    // Reuses the entry of a dead thread, the pools keep their chunks
+    void Reset (const ThreadDescription & desc, EventStorage ** tls) {
+        description = desc;
+        CopyName();
+        threadTLS = tls;
+        storage.Reset();
+        isAlive = true;
+    }
+
+private:
+    void CopyName () {
+        if (description.name == nullptr)
+            return;
+
+        strncpy(name, description.name, MAX_NAME_LENGTH - 1);
+        name[MAX_NAME_LENGTH - 1] = 0;
+        description.name = name;
+    }
 };
 using ThreadList = std::vector<ThreadEntry *>;
 
@@ -216,6 +459,19 @@ struct SwitchContextDesc {
 };
 
 
+////////////////////////////////////////////////////////////
+//
+//    WakeupDesc
+//
+/////
+
+struct WakeupDesc {
+    int64_t  timestamp;
+    uint64_t wakerThreadId; // 0 - unknown (e.g. woken from an interrupt)
+    uint64_t wokenThreadId;
+};
+
+
 ////////////////////////////////////////////////////////////
 //
 //    CaptureStatus
@@ -255,14 +511,22 @@ private:
     void DumpEvents (const EventStorage & entry, const EventTime & timeSlice, ScopeData & scope);
     void DumpThread (const ThreadEntry & entry, const EventTime & timeSlice, ScopeData & scope);
     void DumpFiber (const FiberEntry & entry, const EventTime & timeSlice, ScopeData & scope);
+    void DumpCounters (const EventTime & timeSlice, uint32_t boardNumber);
+    void DumpLocks (const EventTime & timeSlice, uint32_t boardNumber);
+    void DumpCoreTimeline (const EventTime & timeSlice, uint32_t boardNumber);
+    void DumpWaitChains (uint32_t boardNumber, uint32_t mainThreadIndex);
+    void DumpAllocations (uint32_t boardNumber);
 
     void CleanupThreadsAndFibers ();
+    void RegisterPendingDescriptions (const EventTime & timeSlice);
 
     MT::Mutex    lock;
     MT::ThreadId mainThreadID;
 
-    ThreadList threads;
-    FiberList  fibers;
+    // Threads register without the lock, the dump works with a snapshot of the registry taken under it
+    ThreadRegistry threadRegistry;
+    ThreadList     threads;
+    FiberList      fibers;
 
     int64 progressReportedLastTimestampMS = 0;
 
@@ -271,14 +535,43 @@ private:
     CallstackCollector callstackCollector;
     SysCallCollector   syscallCollector;
 
+    CoreTimelineCollector coreTimelineCollector;
+    WaitChainCollector    waitChainCollector;
+    AllocationCollector   allocationCollector;
+    LockCollector         lockCollector;
+
 public:
 
     void Activate (bool active);
     bool isActive = false;
 
+    // Set by StartMessage: raw addresses and the module table are sent instead of resolved symbols
+    bool isSymbolResolutionDeferred = false;
+
     // Active Frame (is used as buffer)
     static thread_local EventStorage * storage;
 
+    // Incremented on every start and stop of a capture, odd - a capture is running
+    static MT::Atomic32Base<uint32> captureEpoch;
+
+    // Registration of the calling thread and the epoch its storage was bound for
+    static thread_local ThreadEntry * threadEntry;
+    static thread_local uint32        storageEpoch;
+
+    // Storage of the calling thread, nullptr if there is no capture. Threads bind and unbind it lazily on the
+    // first event after the epoch moved, so starting or stopping a capture never writes the TLS of other threads.
+    static BRO_FORCE_INLINE EventStorage * GetStorage () {
+        if (captureEpoch.LoadRelaxed() != storageEpoch)
+            BindStorage();
+
+        return storage;
+    }
+
+    static void BindStorage ();
+
+    // Never equal to the capture epoch: forces the next event to bind the storage
+    enum : uint32 { UNBOUND_EPOCH = 0xFFFFFFFF };
+
     // Controls sampling routine
     SamplingProfiler * samplingProfiler;
 
@@ -294,9 +587,15 @@ public:
     // Returns thread collection
     const std::vector<ThreadEntry *> & GetThreads() const;
 
+    // Picks up the threads registered since the last snapshot, must be called under the lock
+    void RefreshThreads ();
+
     // Report switch context event
     SwitchContextResult ReportSwitchContext (const SwitchContextDesc & desc);
 
+    // Report thread wakeup event
+    void ReportWakeup (const WakeupDesc & desc);
+
     // Report switch context event
     bool ReportStackWalk (const CallstackDesc & desc);
 
@@ -304,7 +603,7 @@ public:
     void ReportSysCall (const SysCallDesc & desc);
 
     // Starts sampling process
-    void StartSampling ();
+    void StartSampling (const SamplingSettings & settings);
 
     // Serialize and send current profiling progress
     void DumpProgress (const char * message = "");
@@ -318,6 +617,9 @@ public:
     // Serialize and send sampling data
     void DumpSamplingData ();
 
+    // Serialize and send modules of the addresses collected so far
+    void DumpModules ();
+
     // Registers thread and create EventStorage
     bool RegisterThread (const ThreadDescription & description, EventStorage ** slot);
 
@@ -0,0 +1,119 @@
+#include "CoreTimelineCollector.h"
+#include "Core.h"
+
+#include <algorithm>
+
+namespace Brofiler {
+
+////////////////////////////////////////////////////////////
+//
+//    CoreTimelineCollector
+//
+/////
+
+static const int64_t INVALID_TIMESTAMP = -1;
+
+struct CoreInterval {
+    int64_t  start;
+    int64_t  finish;
+    uint32_t core;
+    int32_t  threadIndex;
+
+    bool operator< (const CoreInterval & other) const {
+        return core != other.core ? core < other.core : start < other.start;
+    }
+};
+
+void CoreTimelineCollector::Add (const SwitchContextDesc & desc, bool isNewThreadRegistered) {
+    if (desc.cpuId >= otherProcessStart.size())
+        otherProcessStart.resize(desc.cpuId + 1, INVALID_TIMESTAMP);
+
+    int64_t & start = otherProcessStart[desc.cpuId];
+
+    // Thread id 0 is the idle thread (or unknown, when the tracer sees only our threads)
+    bool isOtherProcess = !isNewThreadRegistered && desc.newThreadId != 0;
+
+    if (isOtherProcess) {
+        // Switches between threads of other processes keep the interval open
+        if (start == INVALID_TIMESTAMP)
+            start = desc.timestamp;
+    }
+    else if (start != INVALID_TIMESTAMP) {
+        CoreSyncData & data = otherProcessBuffer.Add();
+        data.start = start;
+        data.finish = desc.timestamp;
+        data.core = desc.cpuId;
+
+        start = INVALID_TIMESTAMP;
+    }
+}
+
+void CoreTimelineCollector::Clear () {
+    otherProcessBuffer.Clear(false);
+    otherProcessStart.clear();
+}
+
+void CoreTimelineCollector::Serialize (OutputDataStream & stream, const std::vector<ThreadEntry *> & threads, const EventTime & timeSlice) {
+    std::vector<CoreInterval> intervals;
+
+    auto addInterval = [&](int64_t start, int64_t finish, uint32_t core, int32_t threadIndex) {
+        start = std::max(start, timeSlice.start);
+        finish = std::min(finish, timeSlice.finish);
+
+        if (start < finish) {
+            CoreInterval interval = { start, finish, core, threadIndex };
+            intervals.push_back(interval);
+        }
+    };
+
+    for (size_t i = 0; i < threads.size(); ++i) {
+        const SynchronizationBuffer & buffer = threads[i]->storage.synchronizationBuffer;
+        const size_t count = buffer.Size();
+        size_t index = 0;
+
+        buffer.ForEach([&](const SyncData & data) {
+            // The thread was still running when the trace stopped
+            bool isLast = (++index == count);
+            int64_t finish = (isLast && data.finish == data.start) ? timeSlice.finish : data.finish;
+            addInterval(data.start, finish, (uint32_t)data.core, (int32_t)i);
+        });
+    }
+
+    otherProcessBuffer.ForEach([&](const CoreSyncData & data) {
+        addInterval(data.start, data.finish, data.core, -1);
+    });
+
+    for (size_t core = 0; core < otherProcessStart.size(); ++core) {
+        if (otherProcessStart[core] != INVALID_TIMESTAMP) {
+            addInterval(otherProcessStart[core], timeSlice.finish, (uint32_t)core, -1);
+        }
+    }
+
+    std::sort(intervals.begin(), intervals.end());
+
+    uint32_t coreCount = 0;
+    for (size_t i = 0; i < intervals.size(); ++i) {
+        if (i == 0 || intervals[i].core != intervals[i - 1].core) {
+            ++coreCount;
+        }
+    }
+
+    stream << coreCount;
+
+    for (size_t begin = 0; begin < intervals.size();) {
+        size_t end = begin;
+        while (end < intervals.size() && intervals[end].core == intervals[begin].core) {
+            ++end;
+        }
+
+        stream << intervals[begin].core << (uint32_t)(end - begin);
+
+        for (size_t i = begin; i < end; ++i) {
+            stream << intervals[i].start << intervals[i].finish << intervals[i].threadIndex;
+        }
+
+        begin = end;
+    }
+}
+
+} // Brofiler
@@ -0,0 +1,50 @@
+#pragma once
+#include <MTTypes.h>
+
+#include "Brofiler.h"
+#include "MemoryPool.h"
+#include "Serialization.h"
+
+#include <vector>
+
+namespace Brofiler {
+
+struct ThreadEntry;
+struct SwitchContextDesc;
+
+
+////////////////////////////////////////////////////////////
+//
+//    CoreSyncData
+//
+/////
+
+// A core was running threads of other processes
+struct CoreSyncData : public EventTime {
+    uint32_t core;
+};
+
+
+////////////////////////////////////////////////////////////
+//
+//    CoreTimelineCollector
+//
+/////
+
+// Per-CPU occupancy: intervals of our threads come from their SyncData, the collector adds the time
+// stolen by other processes. Fed by the scheduler trace thread only, read after the trace is stopped.
+class CoreTimelineCollector {
+    using CoreSyncBuffer = MemoryPool<CoreSyncData, 1024>;
+    CoreSyncBuffer otherProcessBuffer;
+
+    // Start of the open other process interval for every core, INVALID_TIMESTAMP - none
+    std::vector<int64_t> otherProcessStart;
+public:
+    void Add (const SwitchContextDesc & desc, bool isNewThreadRegistered);
+    void Clear ();
+
+    // Packet: {CoreCount, {Core, IntervalCount, {Start, Finish, ThreadIndex (-1 - other process)}[]}[]}
+    void Serialize (OutputDataStream & stream, const std::vector<ThreadEntry *> & threads, const EventTime & timeSlice);
+};
+
+} // Brofiler
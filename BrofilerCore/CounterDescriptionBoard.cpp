@@ -0,0 +1,56 @@
+#include "CounterDescriptionBoard.h"
+
+namespace Brofiler {
+
+////////////////////////////////////////////////////////////
+//
+//    Shared Data
+//
+/////
+
+static MT::Mutex g_lock;
+
+
+////////////////////////////////////////////////////////////
+//
+//    CounterDescriptionBoard
+//
+/////
+
+CounterDescriptionBoard & CounterDescriptionBoard::Get () {
+    static CounterDescriptionBoard s_instance;
+    return s_instance;
+}
+
+void CounterDescriptionBoard::RegisterDescription (CounterDescription * description) {
+    MT::ScopedGuard guard(g_lock);
+
+    if (description->index == CounterDescription::INVALID_INDEX) {
+        description->index = uint32_t(board.size());
+        board.push_back(description);
+    }
+}
+
+const std::vector<CounterDescription *> & CounterDescriptionBoard::GetCounters () const {
+    return board;
+}
+
+OutputDataStream & operator<< (OutputDataStream & stream, const CounterDescription & ob) {
+    return stream << ob.name << ob.file << ob.line;
+}
+
+OutputDataStream & operator<< (OutputDataStream & stream, const CounterDescriptionBoard & ob) {
+    MT::ScopedGuard guard(g_lock);
+    const std::vector<CounterDescription *> & counters = ob.GetCounters();
+
+    stream << (uint32)counters.size();
+
+    for (auto it = counters.begin(); it != counters.end(); ++it) {
+        const CounterDescription * desc = *it;
+        stream << *desc;
+    }
+
+    return stream;
+}
+
+} // Brofiler
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "Common.h"
+#include "Serialization.h"
+
+namespace Brofiler {
+
+////////////////////////////////////////////////////////////
+//
+//    Forward Declarations
+//
+/////
+
+struct CounterDescription;
+
+
+////////////////////////////////////////////////////////////
+//
+//    CounterDescriptionBoard
+//
+/////
+
+class CounterDescriptionBoard {
+public:
+
+    static CounterDescriptionBoard & Get();
+
+    // Assigns an index to the description on its first dump
+    void RegisterDescription (CounterDescription * description);
+    const std::vector<CounterDescription *> & GetCounters () const;
+
+    friend OutputDataStream & operator<< (OutputDataStream & stream, const CounterDescriptionBoard & ob);
+
+private:
+
+    std::vector<CounterDescription *> board;
+};
+
+OutputDataStream & operator<< (OutputDataStream & stream, const CounterDescription & ob);
+OutputDataStream & operator<< (OutputDataStream & stream, const CounterDescriptionBoard & ob);
+
+} // Brofiler
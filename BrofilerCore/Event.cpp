@@ -24,24 +24,39 @@ EventDescription * EventDescription::Create (
     const char * eventName,
     const char * fileName,
     uint32_t     fileLine,
-    uint32_t     eventColor
+    uint32_t     eventColor,
+    uint32_t     eventGroup
 ) {
     MT::ScopedGuard guard(g_lock);
 
-    EventDescription* result = EventDescriptionBoard::Get().CreateDescription();
-    result->name  = eventName;
-    result->file  = fileName;
-    result->line  = fileLine;
-    result->color = eventColor;
+    EventDescriptionBoard & board = EventDescriptionBoard::Get();
+
+    EventDescription* result = board.CreateDescription();
+    result->name      = eventName;
+    result->file      = fileName;
+    result->line      = fileLine;
+    result->color     = eventColor;
+    result->group     = eventGroup;
+    result->isEnabled = board.IsGroupEnabled(eventGroup);
     return result;
 }
 
+bool EventDescription::Register (EventDescription * description) {
+    EventDescriptionBoard::Get().RegisterDescription(description);
+    return true;
+}
+
 EventDescription::EventDescription ()
     : isSampling(false)
+    , isEnabled(true)
+    , isSwitchedOn(true)
+    , sampleRatio(1)
+    , sampleSlot(INVALID_INDEX)
     , name("")
     , file("")
     , line(0)
     , color(0)
+    , group(Group::Default)
 {
 }
 
@@ -59,25 +74,48 @@ EventDescription & EventDescription::operator= (const EventDescription &) {
 EventData * Event::Start (const EventDescription & description) {
     EventData * result = nullptr;
 
-    if (EventStorage * storage = Core::storage) {
+    if (EventStorage * storage = Core::GetStorage()) {
+        // Skipped scopes stay on the event stack: arguments recorded inside them are dropped, not given to the enclosing event
+        if (!description.isEnabled || (description.sampleRatio > 1 && !storage->NextSample(description))) {
+            storage->PushEvent(EventStorage::SKIPPED_EVENT);
+            return &storage->skippedEvent;
+        }
+
         result = &storage->NextEvent();
+        storage->PushEvent((uint32)storage->eventBuffer.Size() - 1);
         result->description = &description;
         result->Start();
 
+        storage->PushScope(description);
+
         if (description.isSampling) {
             storage->isSampling.IncFetch();
         }
+
+        storage->LogScope(result->start, description, description.isSampling ? (uint32)EventStorage::SCOPE_SAMPLING : 0);
     }
     return result;
 }
 
 void Event::Stop(EventData& data) {
+    EventStorage * storage = Core::GetStorage();
+
+    if (storage != nullptr && &data == &storage->skippedEvent) {
+        storage->PopEvent();
+        return;
+    }
+
     data.Stop();
 
-    if (data.description->isSampling) {
-        if (EventStorage * storage = Core::storage) {
+    if (storage != nullptr) {
+        storage->PopEvent();
+        storage->PopScope();
+
+        if (data.description->isSampling) {
             storage->isSampling.DecFetch();
         }
+
+        storage->LogScope(data.finish, *data.description, EventStorage::SCOPE_LEAVE | (data.description->isSampling ? (uint32)EventStorage::SCOPE_SAMPLING : 0));
     }
 }
 
@@ -113,7 +151,7 @@ void FiberSyncData::DetachFromThread(EventStorage* storage) {
 /////
 
 OutputDataStream & operator<< (OutputDataStream & stream, const EventDescription & ob) {
-    uint8_t flags = (ob.isSampling ? 0x1 : 0);
+    uint8_t flags = (ob.isSampling ? 0x1 : 0) | (ob.isEnabled ? 0 : 0x2);
     return stream << ob.name << ob.file << ob.line << ob.color << flags;
 }
 
@@ -142,10 +180,142 @@ OutputDataStream & operator<< (OutputDataStream & stream, const FiberSyncData &
 
 Category::Category (const EventDescription& description) : Event(description) {
     if (data) {
-        if (EventStorage* storage = Core::storage) {
-            storage->RegisterCategory(*data);
+        if (EventStorage* storage = Core::GetStorage()) {
+            if (data != &storage->skippedEvent) {
+                storage->RegisterCategory(*data);
+            }
         }
     }
 }
 
+
+////////////////////////////////////////////////////////////
+//
+//    Counter
+//
+/////
+
+void Counter::Set (CounterDescription & description, double value) {
+    if (EventStorage * storage = Core::GetStorage()) {
+        CounterData & data = storage->counterBuffer.Add();
+        data.timestamp = GetHighPrecisionTime();
+        data.description = &description;
+        data.value = value;
+    }
+}
+
+
+////////////////////////////////////////////////////////////
+//
+//    Lock
+//
+/////
+
+static BRO_FORCE_INLINE void AddLockEvent (uint64_t lockId, LockData::Type type) {
+    if (EventStorage * storage = Core::GetStorage()) {
+        LockData & data = storage->lockBuffer.Add();
+        data.timestamp = GetHighPrecisionTime();
+        data.lockId = lockId;
+        data.type = type;
+    }
+}
+
+void Lock::WaitBegin (uint64_t lockId) {
+    AddLockEvent(lockId, LockData::WAIT_BEGIN);
+}
+
+void Lock::WaitEnd (uint64_t lockId) {
+    AddLockEvent(lockId, LockData::WAIT_END);
+}
+
+void Lock::Acquired (uint64_t lockId) {
+    AddLockEvent(lockId, LockData::ACQUIRED);
+}
+
+void Lock::Released (uint64_t lockId) {
+    AddLockEvent(lockId, LockData::RELEASED);
+}
+
+
+////////////////////////////////////////////////////////////
+//
+//    Allocation
+//
+/////
+
+// Growing the buffer may call the hooked allocator again
+static thread_local bool isRecordingAllocation = false;
+
+static BRO_FORCE_INLINE void AddAllocation (const void * pointer, uint64_t size, AllocationData::Type type) {
+    EventStorage * storage = Core::GetStorage();
+    if (storage == nullptr || isRecordingAllocation)
+        return;
+
+    isRecordingAllocation = true;
+
+    AllocationData & data = storage->allocationBuffer.Add();
+    data.timestamp = GetHighPrecisionTime();
+    data.pointer = pointer;
+    data.size = size;
+    data.scope = storage->GetCurrentScope();
+    data.type = type;
+
+    isRecordingAllocation = false;
+}
+
+void Allocation::Alloc (const void * pointer, uint64_t size) {
+    if (pointer != nullptr)
+        AddAllocation(pointer, size, AllocationData::ALLOC);
+}
+
+void Allocation::Free (const void * pointer) {
+    if (pointer != nullptr)
+        AddAllocation(pointer, 0, AllocationData::FREE);
+}
+
+
+////////////////////////////////////////////////////////////
+//
+//    Argument
+//
+/////
+
+static BRO_FORCE_INLINE ArgumentData * NextArgument (const char * name, ArgumentData::Type type) {
+    if (EventStorage * storage = Core::GetStorage()) {
+        const uint32 eventIndex = storage->GetCurrentEvent();
+        if (eventIndex == EventStorage::SKIPPED_EVENT)
+            return nullptr;
+
+        ArgumentData & data = storage->argumentBuffer.Add();
+        data.eventIndex = eventIndex;
+        data.name = name;
+        data.type = type;
+        return &data;
+    }
+
+    return nullptr;
+}
+
+void Argument::AddInteger (const char * name, int64_t value) {
+    if (ArgumentData * data = NextArgument(name, ArgumentData::Integer))
+        data->asInteger = value;
+}
+
+void Argument::AddFloat (const char * name, double value) {
+    if (ArgumentData * data = NextArgument(name, ArgumentData::Float))
+        data->asFloat = value;
+}
+
+void Argument::AddString (const char * name, const char * value) {
+    if (ArgumentData * data = NextArgument(name, ArgumentData::String)) {
+        size_t length = value ? strlen(value) : 0;
+        if (length > MAX_STRING_LENGTH)
+            length = MAX_STRING_LENGTH;
+
+        if (length > 0)
+            memcpy(data->asString, value, length);
+        data->asString[length] = 0;
+    }
+}
+
 } // Brofiler
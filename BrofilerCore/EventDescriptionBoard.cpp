@@ -12,6 +12,25 @@ namespace Brofiler {
 static MT::Mutex g_lock;
 
 
+////////////////////////////////////////////////////////////
+//
+//    Description Section
+//
+/////
+
+#if BRO_MSVC
+// Sections are sorted by the name suffix, entries ("brodesc$m") are placed between the markers
+#pragma section("brodesc$a", read)
+#pragma section("brodesc$z", read)
+__declspec(allocate("brodesc$a")) static EventDescription * const s_sectionBegin = nullptr;
+__declspec(allocate("brodesc$z")) static EventDescription * const s_sectionEnd   = nullptr;
+#elif !defined(__APPLE__)
+// Defined by the linker around the "brodesc" section of the executable, null if no entry was linked in
+extern "C" EventDescription * const __start_brodesc[] __attribute__((weak));
+extern "C" EventDescription * const __stop_brodesc[] __attribute__((weak));
+#endif
+
+
 ////////////////////////////////////////////////////////////
 //
 //    EventDescriptionBoard
@@ -24,7 +43,7 @@ EventDescriptionBoard & EventDescriptionBoard::Get () {
 }
 
 EventDescriptionBoard::~EventDescriptionBoard () {
-    for (auto it = board.begin(); it != board.end(); ++it) {
+    for (auto it = createdDescriptions.begin(); it != createdDescriptions.end(); ++it) {
         EventDescription * desc = *it;
         delete desc;
     }
@@ -45,6 +64,107 @@ void EventDescriptionBoard::SetSamplingFlag (int index, bool flag) {
     }
 }
 
+void EventDescriptionBoard::SetEnabledFlag (int index, bool flag) {
+    MT::ScopedGuard guard(g_lock);
+    BRO_VERIFY(index < (int)board.size(), "Invalid EventDescription index", return);
+
+    if (index < 0) {
+        for (auto it = board.begin(); it != board.end(); ++it) {
+            EventDescription * desc = *it;
+            desc->isSwitchedOn = flag;
+            desc->isEnabled = flag && IsGroupEnabled(desc->group);
+        }
+    }
+    else {
+        EventDescription * desc = board[index];
+        desc->isSwitchedOn = flag;
+        desc->isEnabled = flag && IsGroupEnabled(desc->group);
+    }
+}
+
+void EventDescriptionBoard::SetGroupMask (uint32_t mask) {
+    MT::ScopedGuard guard(g_lock);
+    groupMask = mask;
+
+    for (auto it = board.begin(); it != board.end(); ++it) {
+        EventDescription * desc = *it;
+        desc->isEnabled = desc->isSwitchedOn && IsGroupEnabled(desc->group);
+    }
+}
+
+void EventDescriptionBoard::SetSampleRatio (int index, uint32_t ratio) {
+    MT::ScopedGuard guard(g_lock);
+    BRO_VERIFY(index < (int)board.size(), "Invalid EventDescription index", return);
+
+    if (ratio == 0)
+        ratio = 1;
+
+    const int64_t timestamp = GetHighPrecisionTime();
+
+    if (index < 0) {
+        // Descriptions which aren't subsampled are left alone, the slots are too few to cover the whole board
+        for (auto it = board.begin(); it != board.end(); ++it) {
+            if ((*it)->sampleRatio > 1) {
+                ApplySampleRatio(*it, ratio, timestamp);
+            }
+        }
+    }
+    else {
+        ApplySampleRatio(board[index], ratio, timestamp);
+    }
+}
+
+void EventDescriptionBoard::ApplySampleRatio (EventDescription * desc, uint32_t ratio, int64_t timestamp) {
+    if (desc->sampleRatio == ratio)
+        return;
+
+    // A description owns its slot while its ratio is above 1. The slot is published before the ratio,
+    // a thread which sees ratio > 1 always has a valid counter; a released slot number stays in the description,
+    // so a thread which still sees the old ratio only shares the counter with the next owner.
+    if (ratio > 1 && desc->sampleRatio == 1) {
+        if (!freeSampleSlots.empty()) {
+            desc->sampleSlot = freeSampleSlots.back();
+            freeSampleSlots.pop_back();
+        }
+        else if (sampleSlotCount < EventDescription::MAX_SAMPLE_SLOTS) {
+            desc->sampleSlot = sampleSlotCount++;
+        }
+        else {
+            BRO_FAILED("Out of sample slots, the ratio change is ignored");
+            return;
+        }
+    }
+
+    desc->sampleRatio = ratio;
+    sampleRatioLog.push_back(SampleRatioChange{timestamp, desc->index, ratio});
+
+    if (ratio == 1) {
+        freeSampleSlots.push_back(desc->sampleSlot);
+    }
+}
+
+void EventDescriptionBoard::StartSampleRatioLog (int64_t timestamp) {
+    MT::ScopedGuard guard(g_lock);
+    sampleRatioLog.clear();
+
+    for (auto it = board.begin(); it != board.end(); ++it) {
+        const EventDescription * desc = *it;
+        if (desc->sampleRatio > 1) {
+            sampleRatioLog.push_back(SampleRatioChange{timestamp, desc->index, desc->sampleRatio});
+        }
+    }
+}
+
+void EventDescriptionBoard::SerializeSampleRatios (OutputDataStream & stream) const {
+    MT::ScopedGuard guard(g_lock);
+
+    stream << (uint32)sampleRatioLog.size();
+
+    for (auto it = sampleRatioLog.begin(); it != sampleRatioLog.end(); ++it) {
+        stream << it->index << it->ratio << it->timestamp;
+    }
+}
+
 bool EventDescriptionBoard::HasSamplingEvents () const {
     MT::ScopedGuard guard(g_lock);
     for (auto it = board.begin(); it != board.end(); ++it) {
@@ -66,9 +186,38 @@ EventDescription * EventDescriptionBoard::CreateDescription () {
     EventDescription * desc = new EventDescription();
     desc->index = uint32_t(board.size());
     board.push_back(desc);
+    createdDescriptions.push_back(desc);
     return desc;
 }
 
+void EventDescriptionBoard::RegisterStaticDescriptions () {
+#if BRO_MSVC
+    // Incremental linking may pad the section with zeros
+    for (EventDescription * const * it = &s_sectionBegin + 1; it < &s_sectionEnd; ++it) {
+        if (*it != nullptr) {
+            RegisterDescription(*it);
+        }
+    }
+#elif !defined(__APPLE__)
+    // Inlined copies of a function emit their own entries, RegisterDescription skips the repeats
+    for (EventDescription * const * it = __start_brodesc; it < __stop_brodesc; ++it) {
+        if (*it != nullptr) {
+            RegisterDescription(*it);
+        }
+    }
+#endif
+}
+
+void EventDescriptionBoard::RegisterDescription (EventDescription * description) {
+    MT::ScopedGuard guard(g_lock);
+
+    if (description->index == EventDescription::INVALID_INDEX) {
+        description->index = uint32_t(board.size());
+        description->isEnabled = description->isSwitchedOn && IsGroupEnabled(description->group);
+        board.push_back(description);
+    }
+}
+
 OutputDataStream & operator<< (OutputDataStream & stream, const EventDescriptionBoard & ob) {
     MT::ScopedGuard guard(g_lock);
     const std::vector<EventDescription*>& events = ob.GetEvents();
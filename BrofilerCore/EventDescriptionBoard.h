@@ -30,14 +30,51 @@ public:
     void SetSamplingFlag (int index, bool flag);
     bool HasSamplingEvents () const;
 
+    // Toggles recording of a single description (index < 0 - all of them), a switched off description stays off whatever the group mask is
+    void SetEnabledFlag (int index, bool flag);
+
+    // Enables descriptions which share at least one bit with the mask and are not switched off, disables the rest
+    void SetGroupMask (uint32_t mask);
+    uint32_t GetGroupMask () const { return groupMask; }
+    bool IsGroupEnabled (uint32_t group) const { return (group & groupMask) != 0; }
+
+    // Records only every Nth invocation of a description (index < 0 - all subsampled ones), every change is logged with its timestamp.
+    // At most EventDescription::MAX_SAMPLE_SLOTS descriptions are subsampled at once, a slot is released when the ratio returns to 1.
+    void SetSampleRatio (int index, uint32_t ratio);
+
+    // Restarts the ratio log from the ratios in force at the capture start
+    void StartSampleRatioLog (int64_t timestamp);
+
+    // Writes the ratio log as {index, ratio, timestamp}, so the reader scales every event by the ratio it was recorded with
+    void SerializeSampleRatios (OutputDataStream & stream) const;
+
     EventDescription * CreateDescription ();
+
+    // Registers descriptions listed in the linker section, called once on Core startup
+    void RegisterStaticDescriptions ();
+
+    // Assigns an index to a static description which wasn't found in the linker section (other images, entries dropped by the linker)
+    void RegisterDescription (EventDescription * description);
     const std::vector<EventDescription *> & GetEvents () const;
 
     friend OutputDataStream & operator<< (OutputDataStream & stream, const EventDescriptionBoard & ob);
 
 private:
 
+    struct SampleRatioChange {
+        int64_t  timestamp;
+        uint32_t index;
+        uint32_t ratio;
+    };
+
+    void ApplySampleRatio (EventDescription * desc, uint32_t ratio, int64_t timestamp);
+
     std::vector<EventDescription *> board;
+    std::vector<SampleRatioChange> sampleRatioLog;
+    uint32_t sampleSlotCount = 0;
+    std::vector<uint32_t> freeSampleSlots;
+    std::vector<EventDescription *> createdDescriptions;
+    uint32_t groupMask = Group::All;
 };
 
 OutputDataStream & operator<< (OutputDataStream & stream, const EventDescriptionBoard & ob);
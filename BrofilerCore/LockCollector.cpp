@@ -0,0 +1,186 @@
+#include "LockCollector.h"
+#include "Core.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+namespace Brofiler {
+
+////////////////////////////////////////////////////////////
+//
+//    LockCollector
+//
+/////
+
+namespace {
+
+struct LockInterval : public EventTime {
+    uint32_t lockIndex;
+    uint8_t  type; // 0 - wait, 1 - hold
+};
+
+struct LockStats {
+    uint64_t lockId;
+    uint32_t waitCount;
+    int64_t  waitTime;
+    int64_t  maxWait;
+    uint32_t holdCount;
+    int64_t  holdTime;
+    int64_t  maxHold;
+};
+
+struct LockTable {
+    std::unordered_map<uint64_t, uint32_t> indices;
+    std::vector<LockStats> stats;
+
+    uint32_t GetIndex (uint64_t lockId) {
+        auto it = indices.find(lockId);
+        if (it != indices.end())
+            return it->second;
+
+        LockStats lock = { lockId, 0, 0, 0, 0, 0, 0 };
+        stats.push_back(lock);
+        return indices[lockId] = (uint32_t)(stats.size() - 1);
+    }
+};
+
+const int64_t LOCK_NOT_OPEN = -1;
+
+// Per-lock state of a single thread, holds are counted to support recursive locks
+struct LockState {
+    int64_t  waitStart = LOCK_NOT_OPEN;
+    int64_t  holdStart = LOCK_NOT_OPEN;
+    uint32_t holdDepth = 0;
+};
+
+void AddLockInterval (std::vector<LockInterval> & intervals, LockTable & table, uint64_t lockId, uint8_t type, int64_t start, int64_t finish, const EventTime & timeSlice) {
+    if (finish < timeSlice.start || start > timeSlice.finish)
+        return;
+
+    LockInterval interval;
+    interval.start = std::max(start, timeSlice.start);
+    interval.finish = std::min(finish, timeSlice.finish);
+    interval.lockIndex = table.GetIndex(lockId);
+    interval.type = type;
+    intervals.push_back(interval);
+
+    LockStats & stats = table.stats[interval.lockIndex];
+    const int64_t duration = interval.finish - interval.start;
+
+    if (type == 0) {
+        ++stats.waitCount;
+        stats.waitTime += duration;
+        stats.maxWait = std::max(stats.maxWait, duration);
+    } else {
+        ++stats.holdCount;
+        stats.holdTime += duration;
+        stats.maxHold = std::max(stats.maxHold, duration);
+    }
+}
+
+// Pairs the raw lock events of a thread into wait and hold intervals, intervals open at the end of the capture are closed by it
+void CollectLocks (std::vector<LockInterval> & intervals, LockTable & table, const EventStorage & storage, const EventTime & timeSlice) {
+    std::unordered_map<uint64_t, LockState> states;
+
+    storage.lockBuffer.ForEach([&](const LockData & data) {
+        LockState & state = states[data.lockId];
+
+        switch (data.type) {
+        case LockData::WAIT_BEGIN:
+            state.waitStart = data.timestamp;
+            break;
+
+        case LockData::WAIT_END:
+        case LockData::ACQUIRED:
+            if (state.waitStart != LOCK_NOT_OPEN) {
+                AddLockInterval(intervals, table, data.lockId, 0, state.waitStart, data.timestamp, timeSlice);
+                state.waitStart = LOCK_NOT_OPEN;
+            }
+
+            if (data.type == LockData::ACQUIRED && state.holdDepth++ == 0) {
+                state.holdStart = data.timestamp;
+            }
+            break;
+
+        case LockData::RELEASED:
+            // Released without Acquired: the lock was taken before the capture started
+            if (state.holdDepth == 0) {
+                AddLockInterval(intervals, table, data.lockId, 1, timeSlice.start, data.timestamp, timeSlice);
+            } else if (--state.holdDepth == 0) {
+                AddLockInterval(intervals, table, data.lockId, 1, state.holdStart, data.timestamp, timeSlice);
+                state.holdStart = LOCK_NOT_OPEN;
+            }
+            break;
+        }
+    });
+
+    for (auto it = states.begin(); it != states.end(); ++it) {
+        if (it->second.waitStart != LOCK_NOT_OPEN)
+            AddLockInterval(intervals, table, it->first, 0, it->second.waitStart, timeSlice.finish, timeSlice);
+
+        if (it->second.holdStart != LOCK_NOT_OPEN)
+            AddLockInterval(intervals, table, it->first, 1, it->second.holdStart, timeSlice.finish, timeSlice);
+    }
+
+    std::sort(intervals.begin(), intervals.end(), [](const LockInterval & a, const LockInterval & b) {
+        return a.start < b.start;
+    });
+}
+
+void SerializeLockIntervals (OutputDataStream & stream, const std::vector<LockInterval> & intervals) {
+    stream << (uint32_t)intervals.size();
+
+    for (const LockInterval & interval : intervals) {
+        stream << interval.start << interval.finish << interval.lockIndex << interval.type;
+    }
+}
+
+} // namespace
+
+bool LockCollector::Serialize (OutputDataStream & stream, const std::vector<ThreadEntry *> & threads, const std::vector<FiberEntry *> & fibers, const EventTime & timeSlice) {
+    LockTable table;
+
+    std::vector<std::vector<LockInterval>> threadIntervals(threads.size());
+    std::vector<std::vector<LockInterval>> fiberIntervals(fibers.size());
+    uint32_t trackCount = 0;
+
+    for (size_t i = 0; i < threads.size(); ++i) {
+        CollectLocks(threadIntervals[i], table, threads[i]->storage, timeSlice);
+        trackCount += threadIntervals[i].empty() ? 0 : 1;
+    }
+
+    for (size_t i = 0; i < fibers.size(); ++i) {
+        CollectLocks(fiberIntervals[i], table, fibers[i]->storage, timeSlice);
+        trackCount += fiberIntervals[i].empty() ? 0 : 1;
+    }
+
+    if (trackCount == 0)
+        return false;
+
+    stream << (uint32_t)table.stats.size();
+    for (const LockStats & stats : table.stats) {
+        stream << stats.lockId;
+        stream << stats.waitCount << stats.waitTime << stats.maxWait;
+        stream << stats.holdCount << stats.holdTime << stats.maxHold;
+    }
+
+    stream << trackCount;
+
+    for (size_t i = 0; i < threads.size(); ++i) {
+        if (!threadIntervals[i].empty()) {
+            stream << (int32)i << (int32)-1;
+            SerializeLockIntervals(stream, threadIntervals[i]);
+        }
+    }
+
+    for (size_t i = 0; i < fibers.size(); ++i) {
+        if (!fiberIntervals[i].empty()) {
+            stream << (int32)-1 << (int32)i;
+            SerializeLockIntervals(stream, fiberIntervals[i]);
+        }
+    }
+
+    return true;
+}
+
+} // Brofiler
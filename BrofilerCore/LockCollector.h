@@ -0,0 +1,53 @@
+#pragma once
+#include <MTTypes.h>
+
+#include "Brofiler.h"
+#include "MemoryPool.h"
+#include "Serialization.h"
+
+#include <vector>
+
+namespace Brofiler {
+
+struct ThreadEntry;
+struct FiberEntry;
+
+
+////////////////////////////////////////////////////////////
+//
+//    LockData
+//
+/////
+
+struct LockData {
+    enum Type : uint8_t {
+        WAIT_BEGIN,
+        WAIT_END,
+        ACQUIRED,
+        RELEASED,
+    };
+
+    int64_t  timestamp;
+    uint64_t lockId;
+    Type     type;
+};
+
+using LockBuffer = MemoryPool<LockData, 256>;
+
+
+////////////////////////////////////////////////////////////
+//
+//    LockCollector
+//
+/////
+
+// Lock events are recorded into the buffer of the calling thread (EventStorage::lockBuffer) by the Lock* functions,
+// the collector pairs them into wait and hold intervals and aggregates per lock statistics when the capture is dumped.
+class LockCollector {
+public:
+    // Packet: {LockCount, {LockId, WaitCount, WaitTime, MaxWait, HoldCount, HoldTime, MaxHold}[], TrackCount, {ThreadIndex, FiberIndex, IntervalCount, {Start, Finish, LockIndex, Type (0 - wait, 1 - hold)}[]}[]}
+    // Returns false when no locks were recorded in the time slice, nothing is written in that case
+    bool Serialize (OutputDataStream & stream, const std::vector<ThreadEntry *> & threads, const std::vector<FiberEntry *> & fibers, const EventTime & timeSlice);
+};
+
+} // Brofiler
@@ -53,7 +53,7 @@ class MemoryPool {
         chunk = chunk->next;
 
         ++chunkCount;
-    }
+    }
 
 public:
     MemoryPool () : chunk(&root), index(0), chunkCount(1) {}
@@ -86,12 +86,7 @@ public:
     }
 
     BRO_FORCE_INLINE size_t Size () const {
-        size_t count = 0;
-
-        for (const Chunk * it = &root; it != chunk; it = it->next)
-            count += SIZE;
-
-        return count + index;
+        return (size_t)(chunkCount - 1) * SIZE + index;
     }
 
     BRO_FORCE_INLINE bool IsEmpty () const {
@@ -109,6 +104,7 @@ public:
 
         index = 0;
         chunk = &root;
+        chunkCount = 1;
     }
 
     class const_iterator {
@@ -151,6 +147,10 @@ public:
     }
 
     const_iterator end () const {
+        // A full last chunk ends where advance() steps to: the start of the next chunk
+        if (index == SIZE)
+            return const_iterator(chunk->next, 0);
+
         return const_iterator(chunk, index);
     }
 
@@ -46,6 +46,10 @@ class MessageFactory {
         RegisterMessage<StartMessage>();
         RegisterMessage<StopMessage>();
         RegisterMessage<TurnSamplingMessage>();
+        RegisterMessage<SetupHookMessage>();
+        RegisterMessage<TurnEnabledMessage>();
+        RegisterMessage<SetGroupMaskMessage>();
+        RegisterMessage<SetSampleRatioMessage>();
 
         for (uint32_t msg = 0; msg < IMessage::COUNT; ++msg) {
             BRO_ASSERT(factory[msg] != nullptr, "Message is not registered to factory");
@@ -61,18 +65,25 @@ public:
         MessageHeader header;
         str.Read(header);
 
-        size_t length = str.Length();
+        // Every message is parsed from its own body, so optional trailing fields can be detected by the remaining length
+        std::vector<char> buffer(header.length);
+        if (header.length > 0 && !str.Read(buffer.data(), buffer.size()))
+            return nullptr;
+
+        InputDataStream body;
+        body.Append(buffer.data(), buffer.size());
 
         int32 messageType = IMessage::COUNT;
-        str >> messageType;
+        body >> messageType;
 
         BRO_VERIFY(0 <= messageType && messageType < IMessage::COUNT && factory[messageType] != nullptr, "Unknown message type!", return nullptr)
 
-            IMessage* result = factory[messageType](str);
+        IMessage* result = factory[messageType](body);
 
-        if (header.length + str.Length() != length) {
+        if (body.Length() != 0) {
             BRO_FAILED("Message Stream is corrupted! Invalid Protocol?")
-                return nullptr;
+            delete result;
+            return nullptr;
         }
 
         return result;
@@ -117,15 +128,33 @@ IMessage * IMessage::Create(InputDataStream & str) {
 /////
 
 void StartMessage::Apply () {
+    Core::Get().isSymbolResolutionDeferred = (flags & DEFER_SYMBOLS) != 0;
     Core::Get().Activate(true);
 
     if (EventDescriptionBoard::Get().HasSamplingEvents()) {
-        Core::Get().StartSampling();
+        SamplingSettings settings;
+        settings.intervalMicroSeconds = samplingInterval;
+        settings.maxDepth = samplingMaxDepth;
+        settings.sampleBudget = samplingBudget;
+        Core::Get().StartSampling(settings);
     }
 }
 
-IMessage * StartMessage::Create (InputDataStream &) {
-    return new StartMessage();
+IMessage * StartMessage::Create (InputDataStream & stream) {
+    StartMessage * msg = new StartMessage();
+
+    // Sampling settings are optional: older clients send an empty StartMessage
+    if (stream.Length() > 0) {
+        stream >> msg->samplingInterval;
+        stream >> msg->samplingMaxDepth;
+        stream >> msg->samplingBudget;
+    }
+
+    if (stream.Length() > 0) {
+        stream >> msg->flags;
+    }
+
+    return msg;
 }
 
 
@@ -165,4 +194,75 @@ void TurnSamplingMessage::Apply () {
     EventDescriptionBoard::Get().SetSamplingFlag(index, isSampling != 0);
 }
 
+
+////////////////////////////////////////////////////////////
+//
+//    SetupHookMessage
+//
+/////
+
+IMessage * SetupHookMessage::Create (InputDataStream & stream) {
+    SetupHookMessage * msg = new SetupHookMessage();
+    stream >> msg->address;
+    stream >> msg->isHooked;
+    return msg;
+}
+
+void SetupHookMessage::Apply () {
+    // Function hooks are not implemented, the message is consumed to keep the stream in sync
+}
+
+
+////////////////////////////////////////////////////////////
+//
+//    TurnEnabledMessage
+//
+/////
+
+IMessage * TurnEnabledMessage::Create (InputDataStream & stream) {
+    TurnEnabledMessage * msg = new TurnEnabledMessage();
+    stream >> msg->index;
+    stream >> msg->isEnabled;
+    return msg;
+}
+
+void TurnEnabledMessage::Apply () {
+    EventDescriptionBoard::Get().SetEnabledFlag(index, isEnabled != 0);
+}
+
+
+////////////////////////////////////////////////////////////
+//
+//    SetGroupMaskMessage
+//
+/////
+
+IMessage * SetGroupMaskMessage::Create (InputDataStream & stream) {
+    SetGroupMaskMessage * msg = new SetGroupMaskMessage();
+    stream >> msg->groupMask;
+    return msg;
+}
+
+void SetGroupMaskMessage::Apply () {
+    EventDescriptionBoard::Get().SetGroupMask(groupMask);
+}
+
+
+////////////////////////////////////////////////////////////
+//
+//    SetSampleRatioMessage
+//
+/////
+
+IMessage * SetSampleRatioMessage::Create (InputDataStream & stream) {
+    SetSampleRatioMessage * msg = new SetSampleRatioMessage();
+    stream >> msg->index;
+    stream >> msg->ratio;
+    return msg;
+}
+
+void SetSampleRatioMessage::Apply () {
+    EventDescriptionBoard::Get().SetSampleRatio(index, ratio);
+}
+
 } // Brofiler
@@ -10,7 +10,7 @@ namespace Brofiler {
 //
 /////
 
-constexpr uint32_t NETWORK_PROTOCOL_VERSION = 12;
+constexpr uint32_t NETWORK_PROTOCOL_VERSION = 14;
 
 
 ////////////////////////////////////////////////////////////
@@ -32,6 +32,12 @@ struct DataResponse {
         CallstackPack = 8,					// Callstack Pack
         SyscallPack = 9,					// SysCalls Pack
         FiberSynchronization = 10,			// FiberSync Data
+        Counters = 11,						// Counter Tracks
+        ModuleTable = 12,					// Loaded modules for deferred symbolization
+        CoreTimeline = 13,					// Per-CPU occupancy
+        WaitChains = 14,					// Wait-wakeup links and critical paths of frames
+        Locks = 15,						// Lock wait/hold intervals and statistics
+        Allocations = 16,					// Per frame allocation statistics of every scope
     };
 
     uint32_t version;
@@ -57,9 +63,13 @@ OutputDataStream & operator<< (OutputDataStream & os, const DataResponse & val);
 class IMessage {
 public:
     enum Type {
-        Start,
-        Stop,
-        TurnSampling,
+        Start          = 0,
+        Stop           = 1,
+        TurnSampling   = 2,
+        SetupHook      = 3, // Sent by the viewer, hooks are not supported by the core yet
+        TurnEnabled    = 4,
+        SetGroupMask   = 5,
+        SetSampleRatio = 6,
         COUNT,
     };
 
@@ -84,6 +94,15 @@ public:
 };
 
 struct StartMessage : public Message<IMessage::Start> {
+    uint32_t samplingInterval = 300; // microseconds, validated by Core::StartSampling
+    uint32_t samplingMaxDepth = 0;   // 0 - unlimited
+    uint32_t samplingBudget   = 0;   // Samples per capture, 0 - unlimited
+    uint32_t flags            = 0;
+
+    enum Flags : uint32_t {
+        DEFER_SYMBOLS = 1 << 0, // Send raw addresses and the module table, symbols are resolved by the reader
+    };
+
     static IMessage * Create (InputDataStream &);
     virtual void Apply () override;
 };
@@ -101,4 +120,35 @@ struct TurnSamplingMessage : public Message<IMessage::TurnSampling> {
     virtual void Apply () override;
 };
 
+struct SetupHookMessage : public Message<IMessage::SetupHook> {
+    uint64_t address;
+    uint8_t  isHooked;
+
+    static IMessage * Create (InputDataStream & stream);
+    virtual void Apply () override;
+};
+
+struct TurnEnabledMessage : public Message<IMessage::TurnEnabled> {
+    int32   index;
+    uint8_t isEnabled;
+
+    static IMessage * Create (InputDataStream & stream);
+    virtual void Apply () override;
+};
+
+struct SetGroupMaskMessage : public Message<IMessage::SetGroupMask> {
+    uint32_t groupMask;
+
+    static IMessage * Create (InputDataStream & stream);
+    virtual void Apply () override;
+};
+
+struct SetSampleRatioMessage : public Message<IMessage::SetSampleRatio> {
+    int32    index;
+    uint32_t ratio;
+
+    static IMessage * Create (InputDataStream & stream);
+    virtual void Apply () override;
+};
+
 } // Brofiler
@@ -0,0 +1,903 @@
+#if defined(__linux__)
+
+#include "Common.h"
+#include "ElfSymEngine.h"
+
+#include <algorithm>
+#include <cxxabi.h>
+#include <elf.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+
+namespace Brofiler {
+
+////////////////////////////////////////////////////////////
+//
+//    Helpers
+//
+/////
+
+static std::wstring ToWide (const char * str) {
+    std::wstring result;
+
+    // UTF-8 decoding, invalid sequences are taken byte by byte
+    const unsigned char * it = (const unsigned char *)str;
+    while (*it) {
+        uint32_t code = *it++;
+        int extra = (code >= 0xF0) ? 3 : (code >= 0xE0) ? 2 : (code >= 0xC0) ? 1 : 0;
+
+        if (extra > 0) {
+            code &= (0x3F >> extra);
+            for (int i = 0; i < extra && (*it & 0xC0) == 0x80; ++i) {
+                code = (code << 6) | (*it++ & 0x3F);
+            }
+        }
+
+        result.push_back((wchar_t)code);
+    }
+
+    return result;
+}
+
+static std::wstring Demangle (const char * name) {
+    int status = 0;
+    char * demangled = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+    if (status != 0 || demangled == nullptr)
+        return ToWide(name);
+
+    std::wstring result = ToWide(demangled);
+    free(demangled);
+    return result;
+}
+
+
+////////////////////////////////////////////////////////////
+//
+//    ElfFile
+//
+/////
+
+// Read-only mapping of a 64-bit ELF file with bounds-checked access to sections
+class ElfFile {
+public:
+
+    ElfFile ()
+        : data(nullptr)
+        , size(0)
+        , header(nullptr)
+    {
+    }
+
+    ~ElfFile () {
+        if (data) {
+            munmap((void *)data, size);
+        }
+    }
+
+    bool Open (const std::string & path) {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            return false;
+
+        struct stat info;
+        if (fstat(fd, &info) == 0 && info.st_size >= (off_t)sizeof(Elf64_Ehdr)) {
+            void * ptr = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (ptr != MAP_FAILED) {
+                data = (const uint8_t *)ptr;
+                size = (size_t)info.st_size;
+            }
+        }
+
+        close(fd);
+
+        if (!data)
+            return false;
+
+        header = (const Elf64_Ehdr *)data;
+        return memcmp(header->e_ident, ELFMAG, SELFMAG) == 0
+            && header->e_ident[EI_CLASS] == ELFCLASS64
+            && IsInside(header->e_phoff, (uint64_t)header->e_phnum * sizeof(Elf64_Phdr))
+            && IsInside(header->e_shoff, (uint64_t)header->e_shnum * sizeof(Elf64_Shdr));
+    }
+
+    bool IsInside (uint64_t offset, uint64_t length) const {
+        return offset <= size && length <= size - offset;
+    }
+
+    uint32_t GetProgramHeaderCount () const { return header->e_phnum; }
+    const Elf64_Phdr & GetProgramHeader (uint32_t index) const { return ((const Elf64_Phdr *)(data + header->e_phoff))[index]; }
+
+    uint32_t GetSectionCount () const { return header->e_shnum; }
+    const Elf64_Shdr & GetSection (uint32_t index) const { return ((const Elf64_Shdr *)(data + header->e_shoff))[index]; }
+
+    // Section contents, compressed and NOBITS sections are reported as missing
+    bool GetSectionData (const Elf64_Shdr & section, const uint8_t *& ptr, size_t & length) const {
+        if (section.sh_type == SHT_NOBITS || (section.sh_flags & SHF_COMPRESSED) != 0 || !IsInside(section.sh_offset, section.sh_size))
+            return false;
+
+        ptr = data + section.sh_offset;
+        length = (size_t)section.sh_size;
+        return true;
+    }
+
+    const Elf64_Shdr * FindSection (const char * name) const {
+        if (header->e_shstrndx >= GetSectionCount())
+            return nullptr;
+
+        const uint8_t * names = nullptr;
+        size_t namesLength = 0;
+        if (!GetSectionData(GetSection(header->e_shstrndx), names, namesLength))
+            return nullptr;
+
+        for (uint32_t i = 0; i < GetSectionCount(); ++i) {
+            const Elf64_Shdr & section = GetSection(i);
+            if (section.sh_name < namesLength && strncmp((const char *)names + section.sh_name, name, namesLength - section.sh_name) == 0)
+                return &section;
+        }
+
+        return nullptr;
+    }
+
+    bool HasSection (uint32_t type) const {
+        for (uint32_t i = 0; i < GetSectionCount(); ++i) {
+            if (GetSection(i).sh_type == type)
+                return true;
+        }
+
+        return false;
+    }
+
+    std::string GetBuildId () const {
+        static const char HEX[] = "0123456789abcdef";
+
+        for (uint32_t i = 0; i < GetProgramHeaderCount(); ++i) {
+            const Elf64_Phdr & segment = GetProgramHeader(i);
+            if (segment.p_type != PT_NOTE || !IsInside(segment.p_offset, segment.p_filesz))
+                continue;
+
+            const uint8_t * it = data + segment.p_offset;
+            const uint8_t * end = it + segment.p_filesz;
+
+            while (it + sizeof(Elf64_Nhdr) <= end) {
+                const Elf64_Nhdr & note = *(const Elf64_Nhdr *)it;
+                const uint8_t * name = it + sizeof(Elf64_Nhdr);
+                const uint8_t * desc = name + ((note.n_namesz + 3) & ~3u);
+                const uint8_t * next = desc + ((note.n_descsz + 3) & ~3u);
+
+                if (next > end)
+                    break;
+
+                if (note.n_type == NT_GNU_BUILD_ID && note.n_namesz == 4 && memcmp(name, "GNU", 4) == 0) {
+                    std::string result;
+                    for (uint32_t j = 0; j < note.n_descsz; ++j) {
+                        result.push_back(HEX[desc[j] >> 4]);
+                        result.push_back(HEX[desc[j] & 0xF]);
+                    }
+                    return result;
+                }
+
+                it = next;
+            }
+        }
+
+        return std::string();
+    }
+
+    // Difference between the file virtual address and the file offset of the segment which maps fileOffset
+    bool GetLoadAddressDelta (uint64_t fileOffset, uint64_t & delta) const {
+        // Mappings start at the page which contains the segment
+        const uint64_t pageMask = ~((uint64_t)sysconf(_SC_PAGESIZE) - 1);
+
+        for (uint32_t i = 0; i < GetProgramHeaderCount(); ++i) {
+            const Elf64_Phdr & segment = GetProgramHeader(i);
+            if (segment.p_type == PT_LOAD && (segment.p_offset & pageMask) <= fileOffset && fileOffset < segment.p_offset + segment.p_filesz) {
+                delta = segment.p_vaddr - segment.p_offset;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+private:
+
+    const uint8_t *    data;
+    size_t             size;
+    const Elf64_Ehdr * header;
+};
+
+
+////////////////////////////////////////////////////////////
+//
+//    SymbolTableReader
+//
+/////
+
+static void ReadSymbolTables (const ElfFile & file, ElfImage & image) {
+    for (uint32_t i = 0; i < file.GetSectionCount(); ++i) {
+        const Elf64_Shdr & section = file.GetSection(i);
+        if ((section.sh_type != SHT_SYMTAB && section.sh_type != SHT_DYNSYM) || section.sh_link >= file.GetSectionCount())
+            continue;
+
+        const uint8_t * symbols = nullptr;
+        const uint8_t * strings = nullptr;
+        size_t symbolsLength = 0;
+        size_t stringsLength = 0;
+
+        if (!file.GetSectionData(section, symbols, symbolsLength) || !file.GetSectionData(file.GetSection(section.sh_link), strings, stringsLength))
+            continue;
+
+        for (size_t offset = 0; offset + sizeof(Elf64_Sym) <= symbolsLength; offset += sizeof(Elf64_Sym)) {
+            const Elf64_Sym & symbol = *(const Elf64_Sym *)(symbols + offset);
+
+            uint32_t type = ELF64_ST_TYPE(symbol.st_info);
+            if ((type != STT_FUNC && type != STT_GNU_IFUNC) || symbol.st_shndx == SHN_UNDEF || symbol.st_value == 0 || symbol.st_name >= stringsLength)
+                continue;
+
+            const char * name = (const char *)strings + symbol.st_name;
+            size_t nameLength = strnlen(name, stringsLength - symbol.st_name);
+
+            ElfImage::Function function = { symbol.st_value, symbol.st_size, (uint32_t)image.names.size() };
+            image.names.insert(image.names.end(), name, name + nameLength);
+            image.names.push_back(0);
+            image.functions.push_back(function);
+        }
+    }
+
+    // symtab and dynsym overlap: keep one entry per address, preferring the sized one
+    std::sort(image.functions.begin(), image.functions.end(), [](const ElfImage::Function & a, const ElfImage::Function & b) {
+        return a.address < b.address || (a.address == b.address && a.size > b.size);
+    });
+
+    image.functions.erase(std::unique(image.functions.begin(), image.functions.end(), [](const ElfImage::Function & a, const ElfImage::Function & b) {
+        return a.address == b.address;
+    }), image.functions.end());
+
+    // Unsized symbols (assembly) extend up to the next one
+    for (size_t i = 0; i + 1 < image.functions.size(); ++i) {
+        ElfImage::Function & function = image.functions[i];
+        uint64_t gap = image.functions[i + 1].address - function.address;
+        if (function.size == 0 || function.size > gap)
+            function.size = gap;
+    }
+}
+
+
+////////////////////////////////////////////////////////////
+//
+//    LineTableReader
+//
+/////
+
+// DWARF 2-5 .debug_line state machine, rows are emitted for every sequence which does not start at zero
+// (functions discarded by --gc-sections keep their line programs with zero addresses)
+class LineTableReader {
+public:
+
+    LineTableReader (ElfImage & _image, const uint8_t * lineStrings, size_t lineStringsLength, const uint8_t * strings, size_t stringsLength)
+        : image(_image)
+        , debugLineStr(lineStrings)
+        , debugLineStrLength(lineStringsLength)
+        , debugStr(strings)
+        , debugStrLength(stringsLength)
+    {
+    }
+
+    void Read (const uint8_t * data, size_t length) {
+        const uint8_t * end = data + length;
+        while (data < end) {
+            const uint8_t * next = ReadUnit(data, end);
+            if (next == nullptr)
+                break;
+            data = next;
+        }
+
+        std::sort(image.lines.begin(), image.lines.end(), [](const ElfImage::LineRow & a, const ElfImage::LineRow & b) {
+            // Sequence ends go first, so that a sequence starting at the same address wins the lookup
+            return a.address < b.address || (a.address == b.address && a.line == 0 && b.line != 0);
+        });
+    }
+
+private:
+
+    enum {
+        DW_LNS_copy               = 1,
+        DW_LNS_advance_pc         = 2,
+        DW_LNS_advance_line       = 3,
+        DW_LNS_set_file           = 4,
+        DW_LNS_set_column         = 5,
+        DW_LNS_negate_stmt        = 6,
+        DW_LNS_set_basic_block    = 7,
+        DW_LNS_const_add_pc       = 8,
+        DW_LNS_fixed_advance_pc   = 9,
+
+        DW_LNE_end_sequence       = 1,
+        DW_LNE_set_address        = 2,
+
+        DW_LNCT_path              = 1,
+        DW_LNCT_directory_index   = 2,
+
+        DW_FORM_data2             = 0x05,
+        DW_FORM_data4             = 0x06,
+        DW_FORM_data8             = 0x07,
+        DW_FORM_string            = 0x08,
+        DW_FORM_block             = 0x09,
+        DW_FORM_data1             = 0x0b,
+        DW_FORM_strp              = 0x0e,
+        DW_FORM_udata             = 0x0f,
+        DW_FORM_data16            = 0x1e,
+        DW_FORM_line_strp         = 0x1f,
+    };
+
+    struct Cursor {
+        const uint8_t * ptr;
+        const uint8_t * end;
+        bool            isValid;
+
+        Cursor (const uint8_t * _ptr, const uint8_t * _end) : ptr(_ptr), end(_end), isValid(true) {}
+
+        bool Skip (uint64_t count) {
+            if (count > (uint64_t)(end - ptr)) {
+                isValid = false;
+                ptr = end;
+                return false;
+            }
+            ptr += count;
+            return true;
+        }
+
+        uint64_t Fixed (uint32_t count) {
+            uint64_t value = 0;
+            if (count <= 8 && count <= (uint64_t)(end - ptr)) {
+                memcpy(&value, ptr, count); // Little-endian targets only
+            }
+            Skip(count);
+            return value;
+        }
+
+        uint64_t ULEB () {
+            uint64_t value = 0;
+            for (uint32_t shift = 0; ptr < end; shift += 7) {
+                uint8_t byte = *ptr++;
+                if (shift < 64)
+                    value |= (uint64_t)(byte & 0x7F) << shift;
+                if ((byte & 0x80) == 0)
+                    return value;
+            }
+            isValid = false;
+            return value;
+        }
+
+        int64_t SLEB () {
+            int64_t value = 0;
+            uint32_t shift = 0;
+            while (ptr < end) {
+                uint8_t byte = *ptr++;
+                if (shift < 64)
+                    value |= (int64_t)(byte & 0x7F) << shift;
+                shift += 7;
+                if ((byte & 0x80) == 0) {
+                    if (shift < 64 && (byte & 0x40))
+                        value |= -((int64_t)1 << shift);
+                    return value;
+                }
+            }
+            isValid = false;
+            return value;
+        }
+
+        const char * String () {
+            const uint8_t * begin = ptr;
+            while (ptr < end && *ptr != 0)
+                ++ptr;
+            if (ptr == end) {
+                isValid = false;
+                return "";
+            }
+            ++ptr;
+            return (const char *)begin;
+        }
+    };
+
+    ElfImage &      image;
+    const uint8_t * debugLineStr;
+    size_t          debugLineStrLength;
+    const uint8_t * debugStr;
+    size_t          debugStrLength;
+
+    std::unordered_map<std::string, uint32_t> fileIndices;
+
+    uint32_t AddFile (const std::string & directory, const char * name) {
+        std::string path = (name[0] == '/' || directory.empty()) ? std::string(name) : directory + "/" + name;
+
+        auto it = fileIndices.find(path);
+        if (it != fileIndices.end())
+            return it->second;
+
+        uint32_t index = (uint32_t)image.files.size();
+        image.files.push_back(path);
+        fileIndices.emplace(path, index);
+        return index;
+    }
+
+    static const char * GetString (const uint8_t * strings, size_t length, uint64_t offset) {
+        if (strings == nullptr || offset >= length || memchr(strings + offset, 0, length - offset) == nullptr)
+            return "";
+        return (const char *)strings + offset;
+    }
+
+    // DWARF 5 entry: returns the path and the directory index of a directory/file entry
+    bool ReadEntry (Cursor & cursor, const std::vector<std::pair<uint64_t, uint64_t>> & format, uint32_t offsetSize, const char *& path, uint64_t & directory) {
+        for (const std::pair<uint64_t, uint64_t> & field : format) {
+            const char * str = nullptr;
+            uint64_t value = 0;
+
+            switch (field.second) {
+            case DW_FORM_string:    str = cursor.String(); break;
+            case DW_FORM_line_strp: str = GetString(debugLineStr, debugLineStrLength, cursor.Fixed(offsetSize)); break;
+            case DW_FORM_strp:      str = GetString(debugStr, debugStrLength, cursor.Fixed(offsetSize)); break;
+            case DW_FORM_udata:     value = cursor.ULEB(); break;
+            case DW_FORM_data1:     value = cursor.Fixed(1); break;
+            case DW_FORM_data2:     value = cursor.Fixed(2); break;
+            case DW_FORM_data4:     value = cursor.Fixed(4); break;
+            case DW_FORM_data8:     value = cursor.Fixed(8); break;
+            case DW_FORM_data16:    cursor.Skip(16); break;
+            case DW_FORM_block:     cursor.Skip(cursor.ULEB()); break;
+            default:                return false;
+            }
+
+            if (field.first == DW_LNCT_path && str)
+                path = str;
+            else if (field.first == DW_LNCT_directory_index)
+                directory = value;
+        }
+
+        return cursor.isValid;
+    }
+
+    const uint8_t * ReadUnit (const uint8_t * data, const uint8_t * end) {
+        Cursor cursor(data, end);
+
+        uint32_t offsetSize = 4;
+        uint64_t unitLength = cursor.Fixed(4);
+        if (unitLength == 0xffffffff) {
+            offsetSize = 8;
+            unitLength = cursor.Fixed(8);
+        }
+
+        if (!cursor.isValid || unitLength > (uint64_t)(end - cursor.ptr))
+            return nullptr;
+
+        const uint8_t * unitEnd = cursor.ptr + unitLength;
+        cursor.end = unitEnd;
+
+        uint16_t version = (uint16_t)cursor.Fixed(2);
+        if (version < 2 || version > 5)
+            return unitEnd;
+
+        uint32_t addressSize = 8;
+        if (version >= 5) {
+            addressSize = (uint32_t)cursor.Fixed(1);
+            cursor.Skip(1); // segment_selector_size
+        }
+
+        uint64_t headerLength = cursor.Fixed(offsetSize);
+        if (headerLength > (uint64_t)(unitEnd - cursor.ptr))
+            return unitEnd;
+
+        const uint8_t * program = cursor.ptr + headerLength;
+
+        uint32_t minInstructionLength = (uint32_t)cursor.Fixed(1);
+        if (version >= 4)
+            cursor.Skip(1); // maximum_operations_per_instruction, VLIW only
+        cursor.Skip(1); // default_is_stmt
+        int32_t lineBase = (int8_t)cursor.Fixed(1);
+        uint32_t lineRange = (uint32_t)cursor.Fixed(1);
+        uint32_t opcodeBase = (uint32_t)cursor.Fixed(1);
+
+        if (!cursor.isValid || lineRange == 0 || opcodeBase == 0)
+            return unitEnd;
+
+        const uint8_t * opcodeLengths = cursor.ptr;
+        cursor.Skip(opcodeBase - 1);
+
+        std::vector<std::string> directories;
+        std::vector<uint32_t> files;
+
+        if (version >= 5) {
+            std::vector<std::pair<uint64_t, uint64_t>> format;
+
+            for (int table = 0; table < 2 && cursor.isValid; ++table) {
+                format.resize((size_t)cursor.Fixed(1));
+                for (std::pair<uint64_t, uint64_t> & field : format) {
+                    field.first = cursor.ULEB();
+                    field.second = cursor.ULEB();
+                }
+
+                uint64_t count = cursor.ULEB();
+                for (uint64_t i = 0; i < count && cursor.isValid; ++i) {
+                    const char * path = "";
+                    uint64_t directory = 0;
+                    if (!ReadEntry(cursor, format, offsetSize, path, directory))
+                        return unitEnd;
+
+                    if (table == 0)
+                        directories.push_back(path);
+                    else
+                        files.push_back(AddFile(directory < directories.size() ? directories[(size_t)directory] : std::string(), path));
+                }
+            }
+        }
+        else {
+            // Directory 0 is the compilation directory, which is not part of the line table before DWARF 5
+            directories.push_back(std::string());
+            while (cursor.isValid && cursor.ptr < unitEnd && *cursor.ptr != 0)
+                directories.push_back(cursor.String());
+            cursor.Skip(1);
+
+            // File indices are 1-based
+            files.push_back(0);
+            while (cursor.isValid && cursor.ptr < unitEnd && *cursor.ptr != 0) {
+                const char * path = cursor.String();
+                uint64_t directory = cursor.ULEB();
+                cursor.ULEB(); // mtime
+                cursor.ULEB(); // length
+                files.push_back(AddFile(directory < directories.size() ? directories[(size_t)directory] : std::string(), path));
+            }
+        }
+
+        if (!cursor.isValid || files.empty())
+            return unitEnd;
+
+        cursor.ptr = program;
+        RunProgram(cursor, addressSize, minInstructionLength, lineBase, lineRange, opcodeBase, opcodeLengths, files);
+
+        return unitEnd;
+    }
+
+    void RunProgram (Cursor & cursor, uint32_t addressSize, uint32_t minInstructionLength, int32_t lineBase, uint32_t lineRange, uint32_t opcodeBase, const uint8_t * opcodeLengths, const std::vector<uint32_t> & files) {
+        std::vector<ElfImage::LineRow> sequence;
+
+        uint64_t address = 0;
+        uint64_t file = 1;
+        int64_t line = 1;
+
+        auto emit = [&](uint32_t rowLine) {
+            ElfImage::LineRow row = { address, files[file < files.size() ? (size_t)file : 0], rowLine };
+            sequence.push_back(row);
+        };
+
+        while (cursor.isValid && cursor.ptr < cursor.end) {
+            uint8_t opcode = *cursor.ptr++;
+
+            if (opcode >= opcodeBase) {
+                uint32_t adjusted = opcode - opcodeBase;
+                address += (adjusted / lineRange) * minInstructionLength;
+                line += lineBase + (int32_t)(adjusted % lineRange);
+                emit((uint32_t)std::max<int64_t>(line, 1));
+                continue;
+            }
+
+            switch (opcode) {
+            case 0: {
+                uint64_t length = cursor.ULEB();
+                const uint8_t * next = cursor.ptr + std::min<uint64_t>(length, (uint64_t)(cursor.end - cursor.ptr));
+                uint8_t extended = length > 0 ? (uint8_t)cursor.Fixed(1) : 0;
+
+                if (extended == DW_LNE_end_sequence) {
+                    emit(0);
+                    if (!sequence.empty() && sequence.front().address != 0)
+                        image.lines.insert(image.lines.end(), sequence.begin(), sequence.end());
+                    sequence.clear();
+
+                    address = 0;
+                    file = 1;
+                    line = 1;
+                }
+                else if (extended == DW_LNE_set_address) {
+                    address = cursor.Fixed(std::min<uint32_t>(addressSize, (uint32_t)(length - 1)));
+                }
+
+                cursor.ptr = next;
+                break;
+            }
+            case DW_LNS_copy:             emit((uint32_t)std::max<int64_t>(line, 1)); break;
+            case DW_LNS_advance_pc:       address += cursor.ULEB() * minInstructionLength; break;
+            case DW_LNS_advance_line:     line += cursor.SLEB(); break;
+            case DW_LNS_set_file:         file = cursor.ULEB(); break;
+            case DW_LNS_const_add_pc:     address += ((255 - opcodeBase) / lineRange) * minInstructionLength; break;
+            case DW_LNS_fixed_advance_pc: address += cursor.Fixed(2); break;
+            case DW_LNS_negate_stmt:
+            case DW_LNS_set_basic_block:
+                break;
+            default:
+                // Unknown standard opcodes declare their number of ULEB operands
+                for (uint8_t i = 0; i < opcodeLengths[opcode - 1]; ++i)
+                    cursor.ULEB();
+                break;
+            }
+        }
+    }
+};
+
+static void ReadLineTables (const ElfFile & file, ElfImage & image) {
+    const Elf64_Shdr * debugLine = file.FindSection(".debug_line");
+    const uint8_t * data = nullptr;
+    size_t length = 0;
+
+    if (!debugLine || !file.GetSectionData(*debugLine, data, length))
+        return;
+
+    const uint8_t * lineStrings = nullptr;
+    const uint8_t * strings = nullptr;
+    size_t lineStringsLength = 0;
+    size_t stringsLength = 0;
+
+    if (const Elf64_Shdr * section = file.FindSection(".debug_line_str"))
+        file.GetSectionData(*section, lineStrings, lineStringsLength);
+
+    if (const Elf64_Shdr * section = file.FindSection(".debug_str"))
+        file.GetSectionData(*section, strings, stringsLength);
+
+    LineTableReader reader(image, lineStrings, lineStringsLength, strings, stringsLength);
+    reader.Read(data, length);
+}
+
+
+////////////////////////////////////////////////////////////
+//
+//    ElfImage
+//
+/////
+
+const ElfImage::Function * ElfImage::FindFunction (uint64_t address) const {
+    auto it = std::upper_bound(functions.begin(), functions.end(), address, [](uint64_t value, const Function & function) {
+        return value < function.address;
+    });
+
+    if (it == functions.begin())
+        return nullptr;
+
+    --it;
+    return (it->size == 0 || address - it->address < it->size) ? &*it : nullptr;
+}
+
+const ElfImage::LineRow * ElfImage::FindLine (uint64_t address) const {
+    auto it = std::upper_bound(lines.begin(), lines.end(), address, [](uint64_t value, const LineRow & row) {
+        return value < row.address;
+    });
+
+    if (it == lines.begin())
+        return nullptr;
+
+    --it;
+    return it->line != 0 ? &*it : nullptr;
+}
+
+
+////////////////////////////////////////////////////////////
+//
+//    ElfSymEngine
+//
+/////
+
+static void OpenModule (ElfModule & module) {
+    module.isOpened = true;
+
+    ElfFile file;
+    if (!file.Open(module.path))
+        return;
+
+    module.buildId = file.GetBuildId();
+
+    uint64_t delta = 0;
+    if (file.GetLoadAddressDelta(module.offset, delta))
+        module.bias = module.start - module.offset - delta;
+}
+
+static void LoadModule (ElfModule & module) {
+    module.isLoaded = true;
+
+    ElfFile file;
+    if (!file.Open(module.path))
+        return;
+
+    ReadSymbolTables(file, module.image);
+    ReadLineTables(file, module.image);
+
+    // Stripped binaries: the debug info may be installed separately (/usr/lib/debug/.build-id/xx/yyyy.debug)
+    if ((module.image.lines.empty() || !file.HasSection(SHT_SYMTAB)) && module.buildId.size() > 2) {
+        std::string debugPath = "/usr/lib/debug/.build-id/" + module.buildId.substr(0, 2) + "/" + module.buildId.substr(2) + ".debug";
+
+        ElfFile debugFile;
+        if (debugFile.Open(debugPath)) {
+            if (!file.HasSection(SHT_SYMTAB)) {
+                module.image.functions.clear();
+                module.image.names.clear();
+                ReadSymbolTables(debugFile, module.image);
+            }
+
+            if (module.image.lines.empty())
+                ReadLineTables(debugFile, module.image);
+        }
+    }
+}
+
+ElfSymEngine::ElfSymEngine ()
+    : lastMapRefreshTime(0)
+{
+}
+
+ElfSymEngine::~ElfSymEngine () {
+}
+
+ElfModule * ElfSymEngine::LookupModule (uint64_t address) {
+    auto it = std::upper_bound(elfModules.begin(), elfModules.end(), address, [](uint64_t value, const std::unique_ptr<ElfModule> & module) {
+        return value < module->start;
+    });
+
+    if (it == elfModules.begin())
+        return nullptr;
+
+    --it;
+    return address < (*it)->end ? it->get() : nullptr;
+}
+
+void ElfSymEngine::ReadMemoryMap () {
+    lastMapRefreshTime = MT::GetTimeMilliSeconds();
+
+    FILE * maps = fopen("/proc/self/maps", "r");
+    if (!maps)
+        return;
+
+    // One module per file: the union of its mappings, with the file offset of the lowest one
+    std::vector<std::unique_ptr<ElfModule>> mapped;
+    std::unordered_map<std::string, ElfModule *> byPath;
+    std::unordered_map<std::string, bool> isExecutable;
+
+    char line[4096];
+    while (fgets(line, sizeof(line), maps)) {
+        unsigned long long start = 0, end = 0, offset = 0;
+        char permissions[8] = { 0 };
+        int pathPosition = 0;
+
+        if (sscanf(line, "%llx-%llx %7s %llx %*s %*s %n", &start, &end, permissions, &offset, &pathPosition) < 4 || pathPosition == 0)
+            continue;
+
+        char * path = line + pathPosition;
+        path[strcspn(path, "\n")] = 0;
+
+        // Anonymous memory, [stack], [vdso] and friends
+        if (path[0] != '/')
+            continue;
+
+        if (strchr(permissions, 'x'))
+            isExecutable[path] = true;
+
+        ElfModule *& module = byPath[path];
+        if (!module) {
+            mapped.emplace_back(new ElfModule());
+            module = mapped.back().get();
+            module->path = path;
+            module->start = start;
+            module->end = end;
+            module->offset = offset;
+        }
+        else {
+            if (start < module->start) {
+                module->start = start;
+                module->offset = offset;
+            }
+            module->end = std::max<uint64_t>(module->end, end);
+        }
+    }
+
+    fclose(maps);
+
+    // Modules which are still mapped at the same place keep their parsed tables
+    std::vector<std::unique_ptr<ElfModule>> modules;
+    for (std::unique_ptr<ElfModule> & module : mapped) {
+        if (!isExecutable[module->path])
+            continue;
+
+        auto existing = std::find_if(elfModules.begin(), elfModules.end(), [&](const std::unique_ptr<ElfModule> & other) {
+            return other && other->start == module->start && other->path == module->path;
+        });
+
+        if (existing != elfModules.end()) {
+            (*existing)->end = module->end;
+            modules.push_back(std::move(*existing));
+        }
+        else {
+            modules.push_back(std::move(module));
+        }
+    }
+
+    for (std::unique_ptr<ElfModule> & module : elfModules) {
+        if (module) {
+            retiredModules.push_back(std::move(module));
+        }
+    }
+
+    std::sort(modules.begin(), modules.end(), [](const std::unique_ptr<ElfModule> & a, const std::unique_ptr<ElfModule> & b) {
+        return a->start < b->start;
+    });
+
+    elfModules.swap(modules);
+}
+
+const ElfModule * ElfSymEngine::FindElfModule (uint64_t address, bool loadSymbols) {
+    MT::ScopedGuard guard(lock);
+
+    ElfModule * module = LookupModule(address);
+
+    // Libraries could have been loaded since the last refresh, addresses outside of any file (JIT) must not re-read the map every time
+    if (!module && (elfModules.empty() || MT::GetTimeMilliSeconds() - lastMapRefreshTime > 1000)) {
+        ReadMemoryMap();
+        module = LookupModule(address);
+    }
+
+    if (!module)
+        return nullptr;
+
+    if (!module->isOpened)
+        OpenModule(*module);
+
+    if (loadSymbols && !module->isLoaded)
+        LoadModule(*module);
+
+    return module;
+}
+
+bool ElfSymEngine::GetModule (uint64_t address, SymbolModule & module) {
+    const ElfModule * elfModule = FindElfModule(address, false);
+    if (!elfModule)
+        return false;
+
+    module.base = elfModule->start;
+    module.size = elfModule->end - elfModule->start;
+    module.path = ToWide(elfModule->path.c_str());
+    module.buildId = elfModule->buildId;
+    return true;
+}
+
+bool ElfSymEngine::ResolveSymbol (uint64_t address, Symbol & symbol) {
+    symbol.address = address;
+
+    // Loaded modules are never modified again, so the lookup itself runs without the lock
+    const ElfModule * module = FindElfModule(address, true);
+    if (!module)
+        return true;
+
+    symbol.module = ToWide(module->path.c_str());
+
+    uint64_t fileAddress = address - module->bias;
+    const ElfImage & image = module->image;
+
+    if (const ElfImage::Function * function = image.FindFunction(fileAddress)) {
+        symbol.function = Demangle(&image.names[function->name]);
+        symbol.offset = fileAddress - function->address;
+    }
+
+    if (const ElfImage::LineRow * row = image.FindLine(fileAddress)) {
+        symbol.file = ToWide(image.files[row->file].c_str());
+        symbol.line = row->line;
+    }
+
+    return true;
+}
+
+SymbolEngine * SymbolEngine::Get () {
+    static ElfSymEngine elfSymbolEngine;
+    return &elfSymbolEngine;
+}
+
+} // Brofiler
+
+#endif // __linux__
@@ -0,0 +1,100 @@
+#pragma once
+
+#if defined(__linux__)
+
+#include "../SymbolEngine.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Brofiler {
+
+////////////////////////////////////////////////////////////
+//
+//    ElfImage
+//
+/////
+
+// Lookup tables of one binary, addresses are file virtual addresses
+struct ElfImage {
+    struct Function {
+        uint64_t address;
+        uint64_t size;
+        uint32_t name; // Offset in names
+    };
+
+    struct LineRow {
+        uint64_t address;
+        uint32_t file; // Index in files
+        uint32_t line; // 0 marks the end of a sequence
+    };
+
+    std::vector<Function>    functions; // Sorted by address, non-overlapping
+    std::vector<char>        names;
+    std::vector<LineRow>     lines;     // Sorted by address
+    std::vector<std::string> files;
+
+    const Function * FindFunction (uint64_t address) const;
+    const LineRow * FindLine (uint64_t address) const;
+};
+
+
+////////////////////////////////////////////////////////////
+//
+//    ElfModule
+//
+/////
+
+struct ElfModule {
+    uint64_t    start = 0;  // Mapped address range
+    uint64_t    end = 0;
+    uint64_t    offset = 0; // File offset of the first mapping
+    uint64_t    bias = 0;   // Runtime address - file virtual address
+    std::string path;
+    std::string buildId;
+
+    bool isOpened = false;
+    bool isLoaded = false;
+
+    ElfImage image;
+};
+
+
+////////////////////////////////////////////////////////////
+//
+//    ElfSymEngine
+//
+/////
+
+// Modules are taken from /proc/self/maps. Symbol tables (symtab/dynsym) and DWARF line tables of a module
+// are parsed the first time an address inside of it is resolved, so unrelated shared libraries cost nothing.
+class ElfSymEngine : public SymbolEngine {
+public:
+
+    ElfSymEngine ();
+    ~ElfSymEngine ();
+
+protected:
+
+    bool ResolveSymbol (uint64_t address, Symbol & symbol) override;
+    bool GetModule (uint64_t address, SymbolModule & module) override;
+    bool IsThreadSafe () const override { return true; }
+
+private:
+
+    MT::Mutex lock;
+
+    // Sorted by start address. Unmapped modules are retired instead of deleted: resolving threads may still use them
+    std::vector<std::unique_ptr<ElfModule>> elfModules;
+    std::vector<std::unique_ptr<ElfModule>> retiredModules;
+    int64 lastMapRefreshTime;
+
+    const ElfModule * FindElfModule (uint64_t address, bool loadSymbols);
+    ElfModule * LookupModule (uint64_t address);
+    void ReadMemoryMap ();
+};
+
+} // Brofiler
+
+#endif // __linux__
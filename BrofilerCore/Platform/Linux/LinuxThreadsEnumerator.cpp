@@ -0,0 +1,21 @@
+#if defined(__linux__)
+
+#include "../ThreadsEnumerator.h"
+
+namespace Brofiler {
+
+////////////////////////////////////////////////////////////
+//
+//    Exported
+//
+/////
+
+bool EnumerateAllThreads (std::vector<ThreadInfo> & threads) {
+    // pthread handles of threads which never registered themselves are not reachable from their kernel ids
+    BRO_UNUSED(threads);
+    return false;
+}
+
+} // Brofiler
+
+#endif // __linux__
@@ -0,0 +1,144 @@
+#if defined(__linux__)
+
+#include "PerfEvents.h"
+
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+
+namespace Brofiler {
+
+////////////////////////////////////////////////////////////
+//
+//    PerfEventStream
+//
+/////
+
+PerfEventStream::PerfEventStream ()
+    : fd(-1)
+    , metadata(nullptr)
+    , data(nullptr)
+    , dataSize(0)
+    , mappedSize(0)
+{
+}
+
+PerfEventStream::~PerfEventStream () {
+    Close();
+}
+
+bool PerfEventStream::Open (perf_event_attr & attr, pid_t tid, int cpu, uint32_t pageCount) {
+    Close();
+
+    attr.size = sizeof(perf_event_attr);
+
+    fd = (int)syscall(__NR_perf_event_open, &attr, tid, cpu, -1, PERF_FLAG_FD_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    mappedSize = (pageCount + 1) * pageSize;
+
+    void * ptr = mmap(nullptr, mappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (ptr == MAP_FAILED) {
+        close(fd);
+        fd = -1;
+        return false;
+    }
+
+    metadata = (perf_event_mmap_page *)ptr;
+
+    // Older kernels don't fill data_offset/data_size: the ring starts right after the metadata page
+    uint64_t dataOffset = metadata->data_offset ? metadata->data_offset : pageSize;
+    dataSize = metadata->data_size ? metadata->data_size : pageCount * pageSize;
+    data = (uint8_t *)ptr + dataOffset;
+
+    return true;
+}
+
+bool PerfEventStream::OpenRedirected (perf_event_attr & attr, pid_t tid, int cpu, const PerfEventStream & output) {
+    Close();
+
+    if (!output.IsOpen())
+        return false;
+
+    attr.size = sizeof(perf_event_attr);
+
+    fd = (int)syscall(__NR_perf_event_open, &attr, tid, cpu, -1, PERF_FLAG_FD_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    if (ioctl(fd, PERF_EVENT_IOC_SET_OUTPUT, output.fd) != 0) {
+        close(fd);
+        fd = -1;
+        return false;
+    }
+
+    return true;
+}
+
+void PerfEventStream::Close () {
+    if (metadata) {
+        munmap(metadata, mappedSize);
+        metadata = nullptr;
+        data = nullptr;
+    }
+
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+bool PerfEventStream::Enable () {
+    return fd >= 0 && ioctl(fd, PERF_EVENT_IOC_ENABLE, 0) == 0;
+}
+
+bool PerfEventStream::Disable () {
+    return fd >= 0 && ioctl(fd, PERF_EVENT_IOC_DISABLE, 0) == 0;
+}
+
+void PerfEventStream::SetupClock (perf_event_attr & attr) {
+    attr.use_clockid = 1;
+    attr.clockid = CLOCK_REALTIME;
+}
+
+uint64_t PerfEventStream::monotonicToRealtime = 0;
+
+void PerfEventStream::SetupMonotonicClock (perf_event_attr & attr) {
+    attr.use_clockid = 1;
+    attr.clockid = CLOCK_MONOTONIC;
+
+    // Sampled once per capture: a realtime clock step in the middle of it is not tracked
+    timespec realtime, monotonic;
+    clock_gettime(CLOCK_REALTIME, &realtime);
+    clock_gettime(CLOCK_MONOTONIC, &monotonic);
+
+    monotonicToRealtime = ((uint64_t)realtime.tv_sec * 1000000000ull + (uint64_t)realtime.tv_nsec)
+                        - ((uint64_t)monotonic.tv_sec * 1000000000ull + (uint64_t)monotonic.tv_nsec);
+}
+
+const perf_event_header * PerfEventStream::GetRecord (uint64_t offset) {
+    // Records are 8-byte aligned, so the header itself never wraps
+    uint64_t begin = offset & (dataSize - 1);
+    const perf_event_header * header = (const perf_event_header *)(data + begin);
+
+    if (begin + header->size <= dataSize)
+        return header;
+
+    size_t size = header->size;
+    size_t firstPart = (size_t)(dataSize - begin);
+
+    wrapBuffer.resize(size);
+    memcpy(wrapBuffer.data(), data + begin, firstPart);
+    memcpy(wrapBuffer.data() + firstPart, data, size - firstPart);
+
+    return (const perf_event_header *)wrapBuffer.data();
+}
+
+} // Brofiler
+
+#endif // __linux__
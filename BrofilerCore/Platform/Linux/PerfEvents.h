@@ -0,0 +1,90 @@
+#pragma once
+
+#if defined(__linux__)
+
+#include <linux/perf_event.h>
+#include <sys/types.h>
+#include <stdint.h>
+#include <vector>
+
+namespace Brofiler {
+
+////////////////////////////////////////////////////////////
+//
+//    PerfEventStream
+//
+/////
+
+// perf_event_open descriptor together with its mmap'ed ring buffer.
+// Records are consumed in place without stopping the traced threads.
+class PerfEventStream {
+public:
+    PerfEventStream ();
+    ~PerfEventStream ();
+
+    // pageCount must be a power of two
+    bool Open (perf_event_attr & attr, pid_t tid, int cpu, uint32_t pageCount = 64);
+
+    // Opens the event without a ring of its own: records go to the ring of output (same thread or cpu)
+    bool OpenRedirected (perf_event_attr & attr, pid_t tid, int cpu, const PerfEventStream & output);
+    void Close ();
+
+    bool Enable ();
+    bool Disable ();
+
+    bool IsOpen () const { return fd >= 0; }
+    int GetDescriptor () const { return fd; }
+
+    // Calls func(const perf_event_header & header) for every pending record
+    template<class Func>
+    void Read (Func func);
+
+    // Timestamps are requested in CLOCK_REALTIME to match MT::GetHighFrequencyTime (microseconds)
+    static void SetupClock (perf_event_attr & attr);
+    static int64_t ToProfilerTime (uint64_t perfTime) { return (int64_t)(perfTime / 1000); }
+
+    // Tracepoints accept only NMI-safe clocks: CLOCK_MONOTONIC, shifted to CLOCK_REALTIME when converted
+    static void SetupMonotonicClock (perf_event_attr & attr);
+    static int64_t MonotonicToProfilerTime (uint64_t perfTime) { return (int64_t)((perfTime + monotonicToRealtime) / 1000); }
+
+private:
+    PerfEventStream (const PerfEventStream &);
+    PerfEventStream & operator= (const PerfEventStream &);
+
+    // Returns a contiguous copy of records which wrap around the end of the ring
+    const perf_event_header * GetRecord (uint64_t offset);
+
+    int                    fd;
+    perf_event_mmap_page * metadata;
+    uint8_t *              data;
+    uint64_t               dataSize;
+    size_t                 mappedSize;
+
+    std::vector<uint8_t> wrapBuffer;
+
+    static uint64_t monotonicToRealtime;
+};
+
+template<class Func>
+void PerfEventStream::Read (Func func) {
+    if (metadata == nullptr)
+        return;
+
+    uint64_t head = __atomic_load_n(&metadata->data_head, __ATOMIC_ACQUIRE);
+    uint64_t tail = metadata->data_tail;
+
+    while (tail < head) {
+        const perf_event_header * header = GetRecord(tail);
+        if (header->size == 0)
+            break;
+
+        func(*header);
+        tail += header->size;
+    }
+
+    __atomic_store_n(&metadata->data_tail, head, __ATOMIC_RELEASE);
+}
+
+} // Brofiler
+
+#endif // __linux__
@@ -0,0 +1,333 @@
+#if defined(__linux__)
+
+#include "Common.h"
+#include "Core.h"
+#include "PerfSampler.h"
+#include "SignalSampler.h"
+
+#include <algorithm>
+#include <poll.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace Brofiler {
+
+////////////////////////////////////////////////////////////
+//
+//    PerfSample
+//
+/////
+
+// PERF_RECORD_SAMPLE layout for PERF_SAMPLE_TID | PERF_SAMPLE_TIME | PERF_SAMPLE_CALLCHAIN
+struct PerfSample {
+    perf_event_header header;
+    uint32_t          pid;
+    uint32_t          tid;
+    uint64_t          time;
+    uint64_t          nr;
+    uint64_t          ips[1];
+};
+
+
+////////////////////////////////////////////////////////////
+//
+//    PerfSampler
+//
+/////
+
+PerfSampler::PerfSampler ()
+    : isRunning(0)
+    , wakeupDescriptor(-1)
+{
+}
+
+PerfSampler::~PerfSampler () {
+    StopSampling();
+}
+
+void PerfSampler::SetupAttributes (perf_event_attr & attr, uint32_t samplingInterval) {
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_SOFTWARE;
+    attr.config = PERF_COUNT_SW_TASK_CLOCK;
+    attr.sample_period = (uint64_t)samplingInterval * 1000; // task clock ticks in nanoseconds
+    attr.sample_type = PERF_SAMPLE_TID | PERF_SAMPLE_TIME | PERF_SAMPLE_CALLCHAIN;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.exclude_callchain_kernel = 1;
+
+    // The worker thread sleeps in poll() until the ring is half full
+    attr.watermark = 1;
+    attr.wakeup_watermark = RING_PAGE_COUNT * (uint32_t)sysconf(_SC_PAGESIZE) / 2;
+
+    PerfEventStream::SetupClock(attr);
+}
+
+bool PerfSampler::IsSupported () {
+    perf_event_attr attr;
+    SetupAttributes(attr, 1000);
+
+    PerfEventStream stream;
+    return stream.Open(attr, 0, -1, 1);
+}
+
+void PerfSampler::StartSampling (const std::vector<ThreadEntry *> & threads, const SamplingSettings & samplingSettings) {
+    if (IsActive())
+        StopSampling();
+
+    settings = samplingSettings;
+    ClearCallStacks();
+
+    perf_event_attr attr;
+    SetupAttributes(attr, settings.intervalMicroSeconds);
+
+    for (ThreadEntry * entry : threads) {
+        if (!entry->isAlive || entry->description.fromOtherProcess)
+            continue;
+
+        PerfEventStream * stream = new PerfEventStream();
+        if (!stream->Open(attr, (pid_t)entry->description.systemThreadId, -1, RING_PAGE_COUNT) || !stream->Enable()) {
+            delete stream;
+            continue;
+        }
+
+        Target target;
+        target.entry = entry;
+        target.stream = stream;
+        SyncScopes(target, &entry->storage);
+
+        targets.push_back(target);
+    }
+
+    if (targets.empty())
+        return;
+
+    wakeupDescriptor = eventfd(0, EFD_CLOEXEC);
+
+    isRunning.Store(1);
+    workerThread.Start(64 * 1024, &PerfSampler::AsyncUpdate, this);
+}
+
+bool PerfSampler::StopSampling () {
+    if (!IsActive())
+        return false;
+
+    isRunning.Store(0);
+
+    // Without the eventfd the worker thread leaves on its next timeout
+    if (wakeupDescriptor >= 0) {
+        uint64_t wakeup = 1;
+        ssize_t result = write(wakeupDescriptor, &wakeup, sizeof(wakeup));
+        (void)result;
+    }
+
+    workerThread.Join();
+
+    if (wakeupDescriptor >= 0) {
+        close(wakeupDescriptor);
+        wakeupDescriptor = -1;
+    }
+
+    Disable();
+
+    for (Target & target : targets) {
+        delete target.stream;
+    }
+
+    targets.clear();
+
+    return true;
+}
+
+void PerfSampler::Disable () {
+    for (Target & target : targets) {
+        target.stream->Disable();
+    }
+}
+
+bool PerfSampler::IsActive () const {
+    return !targets.empty();
+}
+
+bool PerfSampler::IsSamplingScope () const {
+    for (const Target & target : targets) {
+        if (const EventStorage * storage = *target.entry->threadTLS) {
+            if (storage->isSampling.Load()) {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+void PerfSampler::SyncScopes (Target & target, const EventStorage * storage) {
+    target.scopeStorage = storage;
+    target.scopeLogPosition = storage->scopeLogCount.Load();
+    target.drainLogCount = target.scopeLogPosition;
+
+    uint32 depth = storage->scopeDepth.Load();
+    for (uint32 i = 0; i < depth && i < EventStorage::MAX_SCOPE_DEPTH; ++i) {
+        target.scopeStack[i] = storage->scopeStack[i];
+    }
+
+    target.scopeDepth = depth;
+    target.samplingDepth = storage->isSampling.Load();
+}
+
+void PerfSampler::ReplayScopes (Target & target, int64_t timestamp) {
+    const EventStorage * storage = target.scopeStorage;
+
+    for (uint32 count = storage->scopeLogCount.Load(); target.scopeLogPosition != count; ++target.scopeLogPosition) {
+        const uint32 position = target.scopeLogPosition;
+        const EventStorage::ScopeLogEntry entry = storage->scopeLog[position & (EventStorage::SCOPE_LOG_SIZE - 1)];
+
+        // The entry was overwritten before (or while) it was copied: slot "position" is reused by "position + SCOPE_LOG_SIZE",
+        // which is being written as soon as the count reaches it
+        if (storage->scopeLogCount.Load() - position >= EventStorage::SCOPE_LOG_SIZE) {
+            SyncScopes(target, storage);
+            return;
+        }
+
+        if (entry.timestamp > timestamp)
+            return;
+
+        if (entry.flags & EventStorage::SCOPE_LEAVE) {
+            if (target.scopeDepth > 0)
+                --target.scopeDepth;
+
+            if ((entry.flags & EventStorage::SCOPE_SAMPLING) && target.samplingDepth > 0)
+                --target.samplingDepth;
+        }
+        else {
+            if (target.scopeDepth < EventStorage::MAX_SCOPE_DEPTH)
+                target.scopeStack[target.scopeDepth] = entry.description;
+
+            ++target.scopeDepth;
+
+            if (entry.flags & EventStorage::SCOPE_SAMPLING)
+                ++target.samplingDepth;
+        }
+    }
+}
+
+void PerfSampler::Drain (Target & target, CallStack & callstack) {
+    // Fibers swap the storage of the thread, the scope log of the new one starts from its live state
+    const EventStorage * storage = *target.entry->threadTLS;
+    if (storage == nullptr)
+        storage = &target.entry->storage;
+
+    if (storage != target.scopeStorage)
+        SyncScopes(target, storage);
+
+    target.stream->Read([&](const perf_event_header & header) {
+        if (header.type != PERF_RECORD_SAMPLE)
+            return;
+
+        const PerfSample & sample = (const PerfSample &)header;
+        const int64_t timestamp = PerfEventStream::ToProfilerTime(sample.time);
+
+        // Every sample is attributed by the scope state at its own timestamp
+        ReplayScopes(target, timestamp);
+
+        if (target.samplingDepth == 0)
+            return;
+
+        const uint32 depth = target.scopeDepth;
+        const EventDescription * scope = depth > 0 ? target.scopeStack[(depth < EventStorage::MAX_SCOPE_DEPTH ? depth : EventStorage::MAX_SCOPE_DEPTH) - 1] : nullptr;
+
+        callstack.clear();
+        for (uint64_t i = 0; i < sample.nr; ++i) {
+            uint64_t address = sample.ips[i];
+
+            // Skip PERF_CONTEXT_USER / PERF_CONTEXT_KERNEL markers
+            if (address >= (uint64_t)PERF_CONTEXT_MAX)
+                continue;
+
+            callstack.push_back((uintptr_t)address);
+        }
+
+        if (!callstack.empty()) {
+            AddCallStack(target.entry->description.threadID.AsUInt64(), (uint64_t)timestamp, scope, callstack.data(), (uint32_t)callstack.size());
+        }
+    });
+}
+
+int PerfSampler::GetDrainTimeout (int64_t elapsedMicroSeconds) {
+    int64_t timeout = (int64_t)MAX_DRAIN_PERIOD_MS * 1000;
+
+    for (Target & target : targets) {
+        const uint32 count = target.scopeStorage->scopeLogCount.Load();
+        const uint32 written = count - target.drainLogCount;
+        target.drainLogCount = count;
+
+        if (written > 0) {
+            timeout = std::min(timeout, elapsedMicroSeconds * (EventStorage::SCOPE_LOG_SIZE / 2) / written);
+        }
+    }
+
+    return (int)std::max(timeout / 1000, (int64_t)MIN_DRAIN_PERIOD_MS);
+}
+
+void PerfSampler::AsyncUpdate (void * _sampler) {
+    PerfSampler & sampler = *(PerfSampler *)_sampler;
+
+    CallStack callstack;
+    callstack.reserve(PERF_MAX_STACK_DEPTH);
+
+    // Rings wake the thread up through their watermark, the timeout keeps the scope logs from wrapping in between
+    std::vector<pollfd> descriptors(sampler.targets.size() + 1);
+    for (size_t i = 0; i < sampler.targets.size(); ++i) {
+        descriptors[i].fd = sampler.targets[i].stream->GetDescriptor();
+        descriptors[i].events = POLLIN;
+    }
+
+    descriptors.back().fd = sampler.wakeupDescriptor;
+    descriptors.back().events = POLLIN;
+
+    bool isEnabled = true;
+    int timeout = MIN_DRAIN_PERIOD_MS;
+    int64_t drainTime = MT::GetTimeMicroSeconds();
+
+    while (sampler.isRunning.Load()) {
+        poll(descriptors.data(), (nfds_t)descriptors.size(), timeout);
+
+        for (size_t i = 0; i < sampler.targets.size(); ++i) {
+            sampler.Drain(sampler.targets[i], callstack);
+
+            // The thread has exited: the event stays readable forever, so it is dropped from the set
+            if (descriptors[i].revents & (POLLHUP | POLLERR))
+                descriptors[i].fd = -1;
+        }
+
+        const int64_t time = MT::GetTimeMicroSeconds();
+        timeout = sampler.GetDrainTimeout(time - drainTime);
+        drainTime = time;
+
+        // Stop the kernel from producing samples which would be dropped anyway
+        if (isEnabled && sampler.IsBudgetExhausted()) {
+            sampler.Disable();
+            isEnabled = false;
+        }
+    }
+
+    for (Target & target : sampler.targets) {
+        sampler.Drain(target, callstack);
+    }
+}
+
+SamplingProfiler * SamplingProfiler::Get () {
+    // perf_event_paranoid may forbid per-thread events for unprivileged processes
+    if (PerfSampler::IsSupported()) {
+        static PerfSampler perfSamplingProfiler;
+        return &perfSamplingProfiler;
+    }
+
+    static SignalSampler signalSamplingProfiler;
+    return &signalSamplingProfiler;
+}
+
+} // Brofiler
+
+#endif // __linux__
@@ -0,0 +1,95 @@
+#pragma once
+
+#if defined(__linux__)
+
+#include "PerfEvents.h"
+#include "../SamplingProfiler.h"
+
+#include <vector>
+
+namespace Brofiler {
+
+////////////////////////////////////////////////////////////
+//
+//    Forward Declarations
+//
+/////
+
+struct ThreadEntry;
+
+
+////////////////////////////////////////////////////////////
+//
+//    PerfSampler
+//
+/////
+
+// Samples registered threads with a per-thread task-clock perf event (PERF_SAMPLE_CALLCHAIN).
+// The kernel unwinds the stacks, so threads are never suspended; the worker thread only drains the rings.
+class PerfSampler : public SamplingProfiler {
+public:
+
+    PerfSampler ();
+    ~PerfSampler ();
+
+    bool IsSamplingScope () const override;
+    bool IsActive () const override;
+
+    void StartSampling (const std::vector<ThreadEntry *> & threads, const SamplingSettings & samplingSettings) override;
+    bool StopSampling () override;
+
+    // Checks whether perf_event_open is permitted for the process (see perf_event_paranoid)
+    static bool IsSupported ();
+
+private:
+
+    struct Target {
+        ThreadEntry *     entry;
+        PerfEventStream * stream;
+
+        // Scope state of the thread at the time of the last drained sample, replayed from the scope log
+        const EventStorage *     scopeStorage;
+        const EventDescription * scopeStack[EventStorage::MAX_SCOPE_DEPTH];
+        uint32                   scopeDepth;
+        uint32                   samplingDepth;
+        uint32                   scopeLogPosition;
+
+        // Scope log count seen by the previous drain, gives the rate the log is filled at
+        uint32                   drainLogCount;
+    };
+
+    enum : uint32_t {
+        RING_PAGE_COUNT     = 64,
+        MIN_DRAIN_PERIOD_MS = 1,
+        MAX_DRAIN_PERIOD_MS = 100,
+    };
+
+    std::vector<Target> targets;
+
+    MT::Thread           workerThread;
+    MT::Atomic32<uint32> isRunning;
+
+    // eventfd which wakes the worker thread up on stop
+    int wakeupDescriptor;
+
+    void Drain (Target & target, CallStack & callstack);
+
+    // Takes the live scope state, used when the log can't be replayed (start, overrun, fiber switch)
+    static void SyncScopes (Target & target, const EventStorage * storage);
+
+    // Applies the logged scope changes up to the timestamp
+    static void ReplayScopes (Target & target, int64_t timestamp);
+
+    // Time until the fastest scope log is half overwritten, judged by its rate since the previous drain
+    int GetDrainTimeout (int64_t elapsedMicroSeconds);
+    void Disable ();
+
+    static void SetupAttributes (perf_event_attr & attr, uint32_t samplingInterval);
+
+    // Called from worker thread
+    static void AsyncUpdate (void * sampler);
+};
+
+} // Brofiler
+
+#endif // __linux__
@@ -0,0 +1,368 @@
+#if defined(__linux__)
+
+#include "Common.h"
+#include "PerfSchedulerTrace.h"
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+// Linux 4.17+, older kernels report every switch-out as voluntary
+#ifndef PERF_RECORD_MISC_SWITCH_OUT_PREEMPT
+#define PERF_RECORD_MISC_SWITCH_OUT_PREEMPT (1 << 14)
+#endif
+
+namespace Brofiler {
+
+////////////////////////////////////////////////////////////
+//
+//    PerfSwitchRecord
+//
+/////
+
+// PERF_RECORD_SWITCH followed by the sample_id_all trailer for PERF_SAMPLE_TID | PERF_SAMPLE_TIME | PERF_SAMPLE_CPU
+struct PerfSwitchRecord {
+    perf_event_header header;
+    uint32_t          pid;
+    uint32_t          tid;
+    uint64_t          time;
+    uint32_t          cpu;
+    uint32_t          reserved;
+};
+
+// Switch-out reasons follow KWAIT_REASON of the ETW tracer, the viewer shows both platforms with one table
+enum PerfSwitchReason : uint8_t {
+    SWITCH_REASON_NONE      = 0,  // Switch-in: the value is not looked at
+    SWITCH_REASON_WAIT      = 6,  // UserRequest: the thread blocked or yielded
+    SWITCH_REASON_PREEMPTED = 32, // WrPreempted: the thread was still runnable
+};
+
+
+////////////////////////////////////////////////////////////
+//
+//    PerfSysCallSample
+//
+/////
+
+// PERF_RECORD_SAMPLE for PERF_SAMPLE_TID | PERF_SAMPLE_TIME | PERF_SAMPLE_RAW of a raw_syscalls tracepoint.
+// Raw data: {uint16 common_type, uint8 common_flags, uint8 common_preempt_count, int32 common_pid, int64 id, ...}
+struct PerfSysCallSample {
+    perf_event_header header;
+    uint32_t          pid;
+    uint32_t          tid;
+    uint64_t          time;
+    uint32_t          rawSize;
+    uint8_t           raw[1];
+
+    static const size_t RAW_TYPE_OFFSET = 0;
+    static const size_t RAW_ID_OFFSET   = 8;
+};
+
+
+////////////////////////////////////////////////////////////
+//
+//    Helpers
+//
+/////
+
+// Tracepoint ids are the numbers in tracefs, which is mounted in one of two places
+static bool ReadTracepointType (const char * name, uint64_t & type) {
+    static const char * const roots[] = { "/sys/kernel/tracing/events/", "/sys/kernel/debug/tracing/events/" };
+
+    for (const char * root : roots) {
+        char path[256];
+        snprintf(path, sizeof(path), "%s%s/id", root, name);
+
+        FILE * file = fopen(path, "r");
+        if (!file)
+            continue;
+
+        unsigned long long value = 0;
+        bool isRead = (fscanf(file, "%llu", &value) == 1);
+        fclose(file);
+
+        if (isRead) {
+            type = value;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// The dummy event produces no samples, only the side-band switch records
+static void SetupSwitchAttributes (perf_event_attr & attr) {
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_SOFTWARE;
+    attr.config = PERF_COUNT_SW_DUMMY;
+    attr.sample_type = PERF_SAMPLE_TID | PERF_SAMPLE_TIME | PERF_SAMPLE_CPU;
+    attr.sample_id_all = 1;
+    attr.context_switch = 1;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    PerfEventStream::SetupClock(attr);
+}
+
+// Tracepoints fire in the kernel, so kernel events can't be excluded here
+static void SetupSysCallAttributes (perf_event_attr & attr, uint64_t type) {
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_TRACEPOINT;
+    attr.config = type;
+    attr.sample_period = 1;
+    attr.sample_type = PERF_SAMPLE_TID | PERF_SAMPLE_TIME | PERF_SAMPLE_RAW;
+    attr.disabled = 1;
+    PerfEventStream::SetupMonotonicClock(attr);
+}
+
+
+////////////////////////////////////////////////////////////
+//
+//    PerfSchedulerTrace
+//
+/////
+
+PerfSchedulerTrace::PerfSchedulerTrace ()
+    : sysEnterType(0)
+    , sysExitType(0)
+    , isSysCallsEnabled(false)
+    , isRunning(0)
+{
+}
+
+PerfSchedulerTrace::~PerfSchedulerTrace () {
+    Stop();
+}
+
+CaptureStatus::Type PerfSchedulerTrace::Start (int mode, const ThreadList & threads, bool autoAddUnknownThreads) {
+    MT::ScopedGuard guard(lock);
+
+    if (!streams.empty())
+        return CaptureStatus::OK;
+
+    BRO_UNUSED(autoAddUnknownThreads);
+
+    if ((mode & SWITCH_CONTEXTS) == 0)
+        return CaptureStatus::FAILED;
+
+    // Unregistered threads can't be attached to on POSIX, so there is nothing to enumerate
+    CaptureStatus::Type res = SchedulerTrace::Start(SWITCH_CONTEXTS, threads, false);
+    if (res != CaptureStatus::OK)
+        return res;
+
+    int error = 0;
+
+    GetActiveThreads()->ForEach([&](uint64 id, ThreadEntry *) {
+        OpenSwitchStream((pid_t)id, error);
+    });
+
+    if (streams.empty()) {
+        SchedulerTrace::Stop();
+        return (error == EACCES || error == EPERM) ? CaptureStatus::ERR_TRACER_ACCESS_DENIED : CaptureStatus::FAILED;
+    }
+
+    // Optional: the capture goes on without syscalls if the tracepoints are not accessible
+    if (mode & SYS_CALLS)
+        isSysCallsEnabled = StartSysCalls();
+
+    isRunning.Store(1);
+    readerThread.Start(64 * 1024, &PerfSchedulerTrace::AsyncUpdate, this);
+
+    return CaptureStatus::OK;
+}
+
+bool PerfSchedulerTrace::Stop () {
+    if (streams.empty())
+        return false;
+
+    isRunning.Store(0);
+    readerThread.Join();
+
+    // Registering threads may be attaching right now
+    MT::ScopedGuard guard(lock);
+
+    for (PerfEventStream * stream : streams) {
+        stream->Disable();
+        Drain(*stream);
+        delete stream;
+    }
+
+    streams.clear();
+
+    StopSysCalls();
+    isSysCallsEnabled = false;
+
+    return SchedulerTrace::Stop();
+}
+
+void PerfSchedulerTrace::AttachThreads (const ThreadList & threads) {
+    MT::ScopedGuard guard(lock);
+
+    if (streams.empty())
+        return;
+
+    // A thread which can't be traced is published anyway, so it is not retried every update
+    ThreadList added;
+    PublishThreads(threads, added);
+
+    for (ThreadEntry * entry : added) {
+        const uint64 id = entry->description.systemThreadId;
+        int error = 0;
+        OpenSwitchStream((pid_t)id, error);
+
+        if (isSysCallsEnabled)
+            OpenSysCallStreams((pid_t)id);
+    }
+}
+
+bool PerfSchedulerTrace::OpenSwitchStream (pid_t threadId, int & error) {
+    perf_event_attr attr;
+    SetupSwitchAttributes(attr);
+
+    PerfEventStream * stream = new PerfEventStream();
+    if (!stream->Open(attr, threadId, -1, 16) || !stream->Enable()) {
+        error = errno;
+        delete stream;
+        return false;
+    }
+
+    streams.push_back(stream);
+    return true;
+}
+
+bool PerfSchedulerTrace::OpenSysCallStreams (pid_t threadId) {
+    perf_event_attr enterAttr;
+    SetupSysCallAttributes(enterAttr, sysEnterType);
+
+    perf_event_attr exitAttr;
+    SetupSysCallAttributes(exitAttr, sysExitType);
+
+    SysCallStreams * threadStreams = new SysCallStreams();
+
+    if (!threadStreams->enter.Open(enterAttr, threadId, -1, 64)
+        || !threadStreams->exit.OpenRedirected(exitAttr, threadId, -1, threadStreams->enter)
+        || !threadStreams->enter.Enable()
+        || !threadStreams->exit.Enable()) {
+        delete threadStreams;
+        return false;
+    }
+
+    sysCallStreams.push_back(threadStreams);
+    return true;
+}
+
+bool PerfSchedulerTrace::StartSysCalls () {
+    if (!ReadTracepointType("raw_syscalls/sys_enter", sysEnterType) || !ReadTracepointType("raw_syscalls/sys_exit", sysExitType))
+        return false;
+
+    GetActiveThreads()->ForEach([&](uint64 id, ThreadEntry *) {
+        OpenSysCallStreams((pid_t)id);
+    });
+
+    return !sysCallStreams.empty();
+}
+
+void PerfSchedulerTrace::StopSysCalls () {
+    for (SysCallStreams * threadStreams : sysCallStreams) {
+        threadStreams->exit.Disable();
+        threadStreams->enter.Disable();
+        DrainSysCalls(threadStreams->enter);
+        delete threadStreams;
+    }
+
+    sysCallStreams.clear();
+}
+
+void PerfSchedulerTrace::Drain (PerfEventStream & stream) {
+    stream.Read([](const perf_event_header & header) {
+        if (header.type != PERF_RECORD_SWITCH || header.size < sizeof(PerfSwitchRecord))
+            return;
+
+        const PerfSwitchRecord & record = (const PerfSwitchRecord &)header;
+
+        // Per-thread records don't name the other thread: 0 never matches a registered thread
+        SwitchContextDesc desc;
+        desc.timestamp = PerfEventStream::ToProfilerTime(record.time);
+        desc.cpuId = (uint8_t)record.cpu;
+
+        if (header.misc & PERF_RECORD_MISC_SWITCH_OUT) {
+            desc.oldThreadId = record.tid;
+            desc.newThreadId = 0;
+            desc.reason = (header.misc & PERF_RECORD_MISC_SWITCH_OUT_PREEMPT) ? SWITCH_REASON_PREEMPTED : SWITCH_REASON_WAIT;
+        }
+        else {
+            desc.oldThreadId = 0;
+            desc.newThreadId = record.tid;
+            desc.reason = SWITCH_REASON_NONE;
+        }
+
+        Core::Get().ReportSwitchContext(desc);
+    });
+}
+
+void PerfSchedulerTrace::DrainSysCalls (PerfEventStream & stream) {
+    stream.Read([this](const perf_event_header & header) {
+        if (header.type != PERF_RECORD_SAMPLE || header.size < offsetof(PerfSysCallSample, raw))
+            return;
+
+        const PerfSysCallSample & sample = (const PerfSysCallSample &)header;
+        if (sample.rawSize < PerfSysCallSample::RAW_ID_OFFSET + sizeof(int64_t) || offsetof(PerfSysCallSample, raw) + sample.rawSize > header.size)
+            return;
+
+        uint16_t type = 0;
+        int64_t id = 0;
+        memcpy(&type, sample.raw + PerfSysCallSample::RAW_TYPE_OFFSET, sizeof(type));
+        memcpy(&id, sample.raw + PerfSysCallSample::RAW_ID_OFFSET, sizeof(id));
+
+        SysCallDesc desc;
+        desc.timestamp = PerfEventStream::MonotonicToProfilerTime(sample.time);
+        desc.id = (uint64_t)id;
+        desc.threadId = sample.tid;
+
+        if (type == sysEnterType)
+            desc.type = SysCallDesc::ENTER;
+        else if (type == sysExitType)
+            desc.type = SysCallDesc::EXIT;
+        else
+            return;
+
+        Core::Get().ReportSysCall(desc);
+    });
+}
+
+void PerfSchedulerTrace::AsyncUpdate (void * _tracer) {
+    PerfSchedulerTrace & tracer = *(PerfSchedulerTrace *)_tracer;
+
+    // Each ring holds 16 pages: thousands of switches, far more than a thread does in 10ms
+    while (tracer.isRunning.Load()) {
+        usleep(10000);
+
+        MT::ScopedGuard guard(tracer.lock);
+
+        for (PerfEventStream * stream : tracer.streams) {
+            tracer.Drain(*stream);
+        }
+
+        for (SysCallStreams * threadStreams : tracer.sysCallStreams) {
+            tracer.DrainSysCalls(threadStreams->enter);
+        }
+    }
+}
+
+
+////////////////////////////////////////////////////////////
+//
+//    SchedulerTrace
+//
+/////
+
+SchedulerTrace * SchedulerTrace::Get () {
+    static PerfSchedulerTrace perfTracer;
+    return &perfTracer;
+}
+
+} // Brofiler
+
+#endif // __linux__
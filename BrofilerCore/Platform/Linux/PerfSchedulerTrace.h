@@ -0,0 +1,69 @@
+#pragma once
+
+#if defined(__linux__)
+
+#include "PerfEvents.h"
+#include "../SchedulerTrace.h"
+
+#include <vector>
+
+namespace Brofiler {
+
+////////////////////////////////////////////////////////////
+//
+//    PerfSchedulerTrace
+//
+/////
+
+// Context switches of registered threads from per-thread perf events (PERF_RECORD_SWITCH, Linux 4.3+).
+// A reader thread drains the rings and feeds Core::ReportSwitchContext the same way the ETW CSwitch handler does.
+// SYS_CALLS uses the raw_syscalls tracepoints when tracefs is readable and perf_event_paranoid allows kernel events,
+// otherwise the capture goes on without syscalls. Stack walks are not traced.
+class PerfSchedulerTrace : public SchedulerTrace {
+public:
+
+    PerfSchedulerTrace ();
+    ~PerfSchedulerTrace ();
+
+    CaptureStatus::Type Start (int mode, const ThreadList & threads, bool autoAddUnknownThreads) override;
+    bool Stop () override;
+
+    void AttachThreads (const ThreadList & threads) override;
+
+private:
+
+    std::vector<PerfEventStream *> streams;
+
+    // Taken by the reader for a whole drain pass: AttachThreads grows the stream lists from registering threads
+    MT::Mutex lock;
+
+    // sys_exit is redirected into the sys_enter ring, so the records of a thread come in order
+    struct SysCallStreams {
+        PerfEventStream enter;
+        PerfEventStream exit;
+    };
+
+    std::vector<SysCallStreams *> sysCallStreams;
+    uint64_t                      sysEnterType;
+    uint64_t                      sysExitType;
+    bool                          isSysCallsEnabled;
+
+    MT::Thread           readerThread;
+    MT::Atomic32<uint32> isRunning;
+
+    void Drain (PerfEventStream & stream);
+    void DrainSysCalls (PerfEventStream & stream);
+
+    bool OpenSwitchStream (pid_t threadId, int & error);
+    bool OpenSysCallStreams (pid_t threadId);
+
+    bool StartSysCalls ();
+    void StopSysCalls ();
+
+    // Called from reader thread
+    static void AsyncUpdate (void * tracer);
+};
+
+} // Brofiler
+
+#endif // __linux__
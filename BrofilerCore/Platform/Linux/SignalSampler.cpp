@@ -0,0 +1,417 @@
+#if defined(__linux__)
+
+#include "Common.h"
+#include "Core.h"
+#include "SignalSampler.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+// Older glibc headers don't expose the SIGEV_THREAD_ID target field
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+namespace Brofiler {
+
+////////////////////////////////////////////////////////////
+//
+//    Shared Data
+//
+/////
+
+// Number of SignalHandler invocations running right now on any thread
+static uint32_t g_handlersInFlight = 0;
+
+
+////////////////////////////////////////////////////////////
+//
+//    Helpers
+//
+/////
+
+// Async-signal-safe: reads only the interrupted context and the thread's own stack
+static uint32_t UnwindFramePointers (const ucontext_t * context, const SignalSampleRing & ring, uintptr_t * frames) {
+    uintptr_t pc = 0;
+    uintptr_t fp = 0;
+
+#if defined(__x86_64__)
+    pc = (uintptr_t)context->uc_mcontext.gregs[REG_RIP];
+    fp = (uintptr_t)context->uc_mcontext.gregs[REG_RBP];
+#elif defined(__aarch64__)
+    pc = (uintptr_t)context->uc_mcontext.pc;
+    fp = (uintptr_t)context->uc_mcontext.regs[29];
+#else
+    BRO_UNUSED(context);
+#endif
+
+    if (pc == 0)
+        return 0;
+
+    uint32_t depth = 0;
+    frames[depth++] = pc;
+
+    while (depth < ring.maxDepth) {
+        if (fp < ring.stackLow || fp + 2 * sizeof(uintptr_t) > ring.stackHigh || (fp & (sizeof(uintptr_t) - 1)) != 0)
+            break;
+
+        const uintptr_t * frame = (const uintptr_t *)fp;
+        uintptr_t next = frame[0];
+        uintptr_t address = frame[1];
+
+        if (address == 0)
+            break;
+
+        frames[depth++] = address;
+
+        // Stack grows down: caller frames must be higher
+        if (next <= fp)
+            break;
+
+        fp = next;
+    }
+
+    return depth;
+}
+
+static void GetThreadStack (pthread_t thread, uintptr_t & low, uintptr_t & high) {
+    low = 0;
+    high = 0;
+
+    pthread_attr_t attr;
+    if (pthread_getattr_np(thread, &attr) != 0)
+        return;
+
+    void * address = nullptr;
+    size_t size = 0;
+    if (pthread_attr_getstack(&attr, &address, &size) == 0) {
+        low = (uintptr_t)address;
+        high = low + size;
+    }
+
+    pthread_attr_destroy(&attr);
+}
+
+// Timers deliver to the thread itself, so the thread pending set ("SigPnd") is checked along with the process one ("ShdPnd")
+static bool IsSignalPending (pid_t systemThreadId, int signal) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/self/task/%d/status", (int)systemThreadId);
+
+    int file = open(path, O_RDONLY | O_CLOEXEC);
+    if (file < 0)
+        return false; // The thread has exited, its pending signals are gone with it
+
+    char buffer[4096];
+    ssize_t length = read(file, buffer, sizeof(buffer) - 1);
+    close(file);
+
+    if (length <= 0)
+        return false;
+
+    buffer[length] = 0;
+
+    const uint64_t mask = 1ull << (signal - 1);
+    const char * keys[] = { "SigPnd:", "ShdPnd:" };
+
+    for (const char * key : keys) {
+        if (const char * line = strstr(buffer, key)) {
+            if ((strtoull(line + strlen(key), nullptr, 16) & mask) != 0) {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+
+////////////////////////////////////////////////////////////
+//
+//    SignalSampler
+//
+/////
+
+SignalSampler::SignalSampler ()
+    : isRunning(0)
+    , isHandlerInstalled(false)
+{
+    memset(&previousAction, 0, sizeof(previousAction));
+}
+
+SignalSampler::~SignalSampler () {
+    StopSampling();
+
+    for (SignalSampleRing * ring : rings) {
+        MT::Memory::Free(ring);
+    }
+}
+
+bool SignalSampler::InstallHandler () {
+    if (isHandlerInstalled)
+        return true;
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = &SignalSampler::SignalHandler;
+    action.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&action.sa_mask);
+
+    isHandlerInstalled = (sigaction(SIGPROF, &action, &previousAction) == 0);
+    return isHandlerInstalled;
+}
+
+void SignalSampler::RestoreHandler () {
+    if (!isHandlerInstalled)
+        return;
+
+    // A signal which was already queued when a timer got deleted is still delivered (and must not hit SIG_DFL),
+    // the handler stays installed until the next StopSampling if such a signal doesn't arrive in time
+    if (!WaitForPendingSignals())
+        return;
+
+    if (sigaction(SIGPROF, &previousAction, nullptr) == 0)
+        isHandlerInstalled = false;
+}
+
+bool SignalSampler::WaitForPendingSignals () {
+    enum : uint32_t {
+        POLL_INTERVAL_US = 1000,
+        MAX_POLL_COUNT   = 100,
+    };
+
+    // A signal leaves the pending set a moment before its handler bumps the counter, so two quiet polls in a row are required
+    uint32_t quietPolls = 0;
+
+    for (uint32_t poll = 0; poll < MAX_POLL_COUNT; ++poll) {
+        bool isPending = __atomic_load_n(&g_handlersInFlight, __ATOMIC_ACQUIRE) != 0;
+
+        for (size_t i = 0; i < signaledThreads.size() && !isPending; ++i) {
+            isPending = IsSignalPending(signaledThreads[i], SIGPROF);
+        }
+
+        quietPolls = isPending ? 0 : quietPolls + 1;
+
+        if (quietPolls == 2) {
+            signaledThreads.clear();
+            return true;
+        }
+
+        usleep(POLL_INTERVAL_US);
+    }
+
+    return false;
+}
+
+void SignalSampler::SignalHandler (int signal, siginfo_t * info, void * context) {
+    BRO_UNUSED(signal);
+
+    __atomic_fetch_add(&g_handlersInFlight, 1, __ATOMIC_ACQ_REL);
+
+    SignalSampleRing * ring = (SignalSampleRing *)info->si_value.sival_ptr;
+    if (ring == nullptr || __atomic_load_n(&ring->isActive, __ATOMIC_ACQUIRE) == 0) {
+        __atomic_fetch_sub(&g_handlersInFlight, 1, __ATOMIC_ACQ_REL);
+        return;
+    }
+
+    // The TLS slot can be replaced by Fibers, so scope state is taken from the storage which is current right now
+    const EventStorage * storage = *ring->entry->threadTLS;
+    if (!storage || !storage->isSampling.Load()) {
+        __atomic_fetch_sub(&g_handlersInFlight, 1, __ATOMIC_ACQ_REL);
+        return;
+    }
+
+    int savedErrno = errno;
+
+    uint32_t head = ring->head;
+    uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+    if (head - tail < SignalSampleRing::CAPACITY) {
+        SignalSampleRing::Slot & slot = ring->slots[head % SignalSampleRing::CAPACITY];
+
+        timespec time;
+        clock_gettime(CLOCK_REALTIME, &time);
+        slot.timestamp = (uint64_t)time.tv_sec * 1000000 + (uint64_t)time.tv_nsec / 1000;
+        slot.scope = storage->GetCurrentScope();
+        slot.depth = UnwindFramePointers((const ucontext_t *)context, *ring, slot.frames);
+
+        __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+    }
+    else {
+        __atomic_fetch_add(&ring->dropped, 1, __ATOMIC_RELAXED);
+    }
+
+    errno = savedErrno;
+
+    __atomic_fetch_sub(&g_handlersInFlight, 1, __ATOMIC_ACQ_REL);
+}
+
+void SignalSampler::StartSampling (const std::vector<ThreadEntry *> & threads, const SamplingSettings & samplingSettings) {
+    if (IsActive())
+        StopSampling();
+
+    settings = samplingSettings;
+    ClearCallStacks();
+
+    uint32_t maxDepth = SignalSampleRing::MAX_DEPTH;
+    if (settings.maxDepth != 0 && settings.maxDepth < maxDepth)
+        maxDepth = settings.maxDepth;
+
+    if (!InstallHandler())
+        return;
+
+    // A late signal of the previous capture refers to its ring, such rings are left alone while it may still arrive
+    const size_t firstRing = WaitForPendingSignals() ? 0 : rings.size();
+
+    for (ThreadEntry * entry : threads) {
+        if (!entry->isAlive || entry->description.fromOtherProcess)
+            continue;
+
+        if (firstRing + targets.size() == rings.size()) {
+            void * ptr = MT::Memory::Alloc(sizeof(SignalSampleRing), BRO_CACHE_LINE_SIZE);
+            rings.push_back(new (ptr) SignalSampleRing());
+        }
+
+        SignalSampleRing * ring = rings[firstRing + targets.size()];
+        pthread_t thread = (pthread_t)entry->description.threadID.AsUInt64();
+
+        ring->entry = entry;
+        ring->head = 0;
+        ring->tail = 0;
+        ring->dropped = 0;
+        ring->maxDepth = maxDepth;
+        GetThreadStack(thread, ring->stackLow, ring->stackHigh);
+
+        // Thread CPU clock: blocked threads are not sampled, the same way the task-clock perf event works
+        clockid_t clock = CLOCK_MONOTONIC;
+        if (pthread_getcpuclockid(thread, &clock) != 0)
+            clock = CLOCK_MONOTONIC;
+
+        sigevent event;
+        memset(&event, 0, sizeof(event));
+        event.sigev_notify = SIGEV_THREAD_ID;
+        event.sigev_signo = SIGPROF;
+        event.sigev_value.sival_ptr = ring;
+        event.sigev_notify_thread_id = (pid_t)entry->description.systemThreadId;
+
+        Target target = { ring, timer_t(), (pid_t)entry->description.systemThreadId };
+        if (timer_create(clock, &event, &target.timer) != 0)
+            continue;
+
+        __atomic_store_n(&ring->isActive, 1, __ATOMIC_RELEASE);
+
+        itimerspec period;
+        period.it_interval.tv_sec = settings.intervalMicroSeconds / 1000000;
+        period.it_interval.tv_nsec = (long)(settings.intervalMicroSeconds % 1000000) * 1000;
+        period.it_value = period.it_interval;
+
+        if (timer_settime(target.timer, 0, &period, nullptr) != 0) {
+            __atomic_store_n(&ring->isActive, 0, __ATOMIC_RELEASE);
+            timer_delete(target.timer);
+            continue;
+        }
+
+        targets.push_back(target);
+    }
+
+    if (targets.empty())
+        return;
+
+    isRunning.Store(1);
+    workerThread.Start(64 * 1024, &SignalSampler::AsyncUpdate, this);
+}
+
+bool SignalSampler::StopSampling () {
+    if (!IsActive()) {
+        RestoreHandler();
+        return false;
+    }
+
+    for (Target & target : targets) {
+        timer_delete(target.timer);
+        __atomic_store_n(&target.ring->isActive, 0, __ATOMIC_RELEASE);
+        signaledThreads.push_back(target.systemThreadId);
+    }
+
+    isRunning.Store(0);
+    workerThread.Join();
+
+    // Rings are reused by the next StartSampling: a late signal must not write into a ring which is active again
+    RestoreHandler();
+
+    targets.clear();
+
+    return true;
+}
+
+void SignalSampler::Disarm () {
+    itimerspec period;
+    memset(&period, 0, sizeof(period));
+
+    for (Target & target : targets) {
+        timer_settime(target.timer, 0, &period, nullptr);
+    }
+}
+
+bool SignalSampler::IsActive () const {
+    return !targets.empty();
+}
+
+bool SignalSampler::IsSamplingScope () const {
+    for (const Target & target : targets) {
+        if (const EventStorage * storage = *target.ring->entry->threadTLS) {
+            if (storage->isSampling.Load()) {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+void SignalSampler::Drain (SignalSampleRing & ring) {
+    uint32_t head = __atomic_load_n(&ring.head, __ATOMIC_ACQUIRE);
+    uint32_t tail = ring.tail;
+
+    for (; tail != head; ++tail) {
+        const SignalSampleRing::Slot & slot = ring.slots[tail % SignalSampleRing::CAPACITY];
+        if (slot.depth > 0) {
+            AddCallStack(ring.entry->description.threadID.AsUInt64(), slot.timestamp, slot.scope, slot.frames, slot.depth);
+        }
+    }
+
+    __atomic_store_n(&ring.tail, tail, __ATOMIC_RELEASE);
+}
+
+void SignalSampler::AsyncUpdate (void * _sampler) {
+    SignalSampler & sampler = *(SignalSampler *)_sampler;
+
+    bool isArmed = true;
+
+    while (sampler.isRunning.Load()) {
+        usleep(sampler.settings.intervalMicroSeconds);
+
+        for (Target & target : sampler.targets) {
+            sampler.Drain(*target.ring);
+        }
+
+        // No point in interrupting threads once the budget is spent
+        if (isArmed && sampler.IsBudgetExhausted()) {
+            sampler.Disarm();
+            isArmed = false;
+        }
+    }
+
+    for (Target & target : sampler.targets) {
+        sampler.Drain(*target.ring);
+    }
+}
+
+} // Brofiler
+
+#endif // __linux__
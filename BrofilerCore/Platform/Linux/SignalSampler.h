@@ -0,0 +1,111 @@
+#pragma once
+
+#if defined(__linux__)
+
+#include "../SamplingProfiler.h"
+
+#include <signal.h>
+#include <time.h>
+#include <vector>
+
+namespace Brofiler {
+
+////////////////////////////////////////////////////////////
+//
+//    Forward Declarations
+//
+/////
+
+struct ThreadEntry;
+
+
+////////////////////////////////////////////////////////////
+//
+//    SignalSampleRing
+//
+/////
+
+// Single producer (signal handler on the sampled thread) / single consumer (collector thread) ring
+struct SignalSampleRing {
+    enum : uint32_t {
+        CAPACITY  = 256,
+        MAX_DEPTH = 64,
+    };
+
+    struct Slot {
+        uint64_t                 timestamp;
+        const EventDescription * scope;
+        uint32_t                 depth;
+        uintptr_t                frames[MAX_DEPTH];
+    };
+
+    ThreadEntry * entry;
+
+    // Frame pointers outside of the thread stack stop unwinding
+    uintptr_t stackLow;
+    uintptr_t stackHigh;
+    uint32_t  maxDepth;
+
+    uint32_t isActive;
+    uint32_t head;    // Written by the signal handler
+    uint32_t tail;    // Written by the collector
+    uint32_t dropped; // Samples lost because the collector fell behind
+
+    Slot slots[CAPACITY];
+};
+
+
+////////////////////////////////////////////////////////////
+//
+//    SignalSampler
+//
+/////
+
+// Fallback for systems where perf_event_open is not permitted.
+// Every registered thread gets a POSIX timer on its CPU clock which delivers SIGPROF to that very thread
+// (SIGEV_THREAD_ID); the handler unwinds frame pointers into the thread's ring, a collector thread drains the rings.
+class SignalSampler : public SamplingProfiler {
+public:
+
+    SignalSampler ();
+    ~SignalSampler ();
+
+    bool IsSamplingScope () const override;
+    bool IsActive () const override;
+
+    void StartSampling (const std::vector<ThreadEntry *> & threads, const SamplingSettings & samplingSettings) override;
+    bool StopSampling () override;
+
+private:
+
+    struct Target {
+        SignalSampleRing * ring;
+        timer_t            timer;
+        pid_t              systemThreadId;
+    };
+
+    std::vector<Target>             targets;
+    std::vector<SignalSampleRing *> rings; // Never released while the sampler is alive: late signals may still refer to them
+    std::vector<pid_t>              signaledThreads; // Threads of deleted timers which may still have a signal pending
+
+    MT::Thread           workerThread;
+    MT::Atomic32<uint32> isRunning;
+
+    bool             isHandlerInstalled;
+    struct sigaction previousAction; // Restored once no signal of ours is in flight
+
+    bool InstallHandler ();
+    void RestoreHandler ();
+    bool WaitForPendingSignals ();
+    void Drain (SignalSampleRing & ring);
+    void Disarm ();
+
+    static void SignalHandler (int signal, siginfo_t * info, void * context);
+
+    // Called from worker thread
+    static void AsyncUpdate (void * sampler);
+};
+
+} // Brofiler
+
+#endif // __linux__
@@ -1,49 +1,222 @@
 #include "SamplingProfiler.h"
 #include "SymbolEngine.h"
+#include "../EventDescriptionBoard.h"
+
+#include <algorithm>
+#include <map>
 
 namespace Brofiler {
 
+////////////////////////////////////////////////////////////
+//
+//    CallStackTree
+//
+/////
+
+CallStackTree::CallStackTree () {
+    Node root = { 0, ROOT, 0, 0, ROOT, ROOT, ROOT };
+    nodes.push_back(root);
+    table.resize(1024, ROOT);
+}
+
+void CallStackTree::Merge (const CallStack & callstack) {
+    if (callstack.empty())
+        return;
+
+    uint32_t node = ROOT;
+    ++nodes[node].invokeCount;
+
+    for (size_t index = callstack.size() - 1; index > 0; --index) {
+        node = FindOrAddChild(node, callstack[index]);
+        ++nodes[node].invokeCount;
+    }
+}
+
+size_t CallStackTree::Hash (uint32_t parent, uint64_t address) {
+    uint64_t key = (address * 0x9E3779B97F4A7C15ull) ^ ((uint64_t)parent * 0xC2B2AE3D27D4EB4Full);
+    return (size_t)(key ^ (key >> 29));
+}
+
+uint32_t CallStackTree::FindOrAddChild (uint32_t parent, uint64_t address) {
+    size_t mask = table.size() - 1;
+    size_t slot = Hash(parent, address) & mask;
+
+    for (; table[slot] != ROOT; slot = (slot + 1) & mask) {
+        const Node & node = nodes[table[slot]];
+        if (node.parent == parent && node.address == address)
+            return table[slot];
+    }
+
+    uint32_t index = (uint32_t)nodes.size();
+    Node child = { address, parent, 0, 0, ROOT, ROOT, ROOT };
+    nodes.push_back(child);
+
+    Node & parentNode = nodes[parent];
+    if (parentNode.lastChild != ROOT)
+        nodes[parentNode.lastChild].nextSibling = index;
+    else
+        parentNode.firstChild = index;
+
+    parentNode.lastChild = index;
+    ++parentNode.childCount;
+
+    addresses.insert(address);
+
+    // Keep load factor below 1/2
+    if (nodes.size() * 2 > table.size()) {
+        Rehash(table.size() * 2);
+    }
+    else {
+        table[slot] = index;
+    }
+
+    return index;
+}
+
+void CallStackTree::Rehash (size_t capacity) {
+    table.assign(capacity, ROOT);
+
+    size_t mask = capacity - 1;
+    for (uint32_t index = 1; index < (uint32_t)nodes.size(); ++index) {
+        size_t slot = Hash(nodes[index].parent, nodes[index].address) & mask;
+        while (table[slot] != ROOT)
+            slot = (slot + 1) & mask;
+
+        table[slot] = index;
+    }
+}
+
+OutputDataStream & CallStackTree::Serialize (OutputDataStream & stream) const {
+    // Preorder traversal, children in the order they were added
+    std::vector<uint32_t> stack;
+    stack.push_back(ROOT);
+
+    while (!stack.empty()) {
+        const Node & node = nodes[stack.back()];
+        stack.pop_back();
+
+        stream << (uint64)node.address << node.invokeCount << node.childCount;
+
+        size_t first = stack.size();
+        for (uint32_t child = node.firstChild; child != ROOT; child = nodes[child].nextSibling) {
+            stack.push_back(child);
+        }
+        std::reverse(stack.begin() + first, stack.end());
+    }
+
+    return stream;
+}
+
+
 ////////////////////////////////////////////////////////////
 //
 //    SamplingProfiler
 //
 /////
 
+bool SamplingProfiler::AddCallStack (uint64_t threadID, uint64_t timestamp, const EventDescription * scope, const uintptr_t * frames, uint32_t depth) {
+    if (IsBudgetExhausted())
+        return false;
+
+    if (settings.maxDepth != 0 && depth > settings.maxDepth)
+        depth = settings.maxDepth;
+
+    if (uint64 * storage = callstacks.TryAdd(depth + 4)) {
+        storage[0] = threadID;
+        storage[1] = timestamp;
+        storage[2] = (uint64)(uintptr_t)scope;
+        storage[3] = depth;
+
+        for (uint32_t i = 0; i < depth; ++i) {
+            storage[4 + i] = frames[i];
+        }
+    }
+    else {
+        callstacks.Add() = threadID;
+        callstacks.Add() = timestamp;
+        callstacks.Add() = (uint64)(uintptr_t)scope;
+        callstacks.Add() = depth;
+
+        for (uint32_t i = 0; i < depth; ++i) {
+            callstacks.Add() = frames[i];
+        }
+    }
+
+    sampleCount.IncFetch();
+    return true;
+}
+
+void SamplingProfiler::ClearCallStacks () {
+    callstacks.Clear(false);
+    sampleCount.Store(0);
+}
+
 OutputDataStream & SamplingProfiler::Serialize (OutputDataStream & stream) {
     BRO_VERIFY(!IsActive(), "Can't serialize active Sampler!", return stream);
 
-    stream << (uint32)callstacks.size();
+    stream << (uint32)sampleCount.Load();
+
+    CallStackTree tree;
 
-    CallStackTreeNode tree;
+    // Samples which landed inside instrumented scopes, by the innermost scope
+    std::map<const EventDescription *, CallStackTree> scopeTrees;
 
     Core::Get().DumpProgress("Merging CallStacks...");
 
-    for (auto it = callstacks.begin(); it != callstacks.end(); ++it) {
-        const CallStack & callstack = *it;
-        if (!callstack.empty()) {
-            tree.Merge(callstack, callstack.size() - 1);
+    CallStack callstack;
+
+    for (CallStackPool::const_iterator it = callstacks.begin(); it != callstacks.end();) {
+        ++it; // Skip ThreadID
+        ++it; // Skip Timestamp
+        const EventDescription * scope = (const EventDescription *)(uintptr_t)*it;
+        ++it;
+        uint64_t depth = *it;
+        ++it;
+
+        callstack.resize((size_t)depth);
+        for (uint64_t i = 0; i < depth; ++i, ++it) {
+            callstack[(size_t)i] = (uintptr_t)*it;
         }
-    }
 
-    std::unordered_set<uint64> addresses;
-    tree.CollectAddresses(addresses);
+        tree.Merge(callstack);
 
-    Core::Get().DumpProgress("Resolving Symbols...");
+        if (scope != nullptr) {
+            scopeTrees[scope].Merge(callstack);
+        }
+    }
+
+    std::unordered_set<uint64> addresses = tree.GetAddresses();
+    for (auto it = scopeTrees.begin(); it != scopeTrees.end(); ++it) {
+        const std::unordered_set<uint64> & scopeAddresses = it->second.GetAddresses();
+        addresses.insert(scopeAddresses.begin(), scopeAddresses.end());
+    }
 
     SymbolEngine * symbolEngine = Core::Get().symbolEngine;
 
+    // Deferred symbolization sends an empty symbol list, the reader maps raw addresses with the module table
     std::vector<const Symbol*> symbols;
-    for (auto it = addresses.begin(); it != addresses.end(); ++it) {
-        uint64_t address = *it;
-        if (const Symbol * symbol = symbolEngine->GetSymbol(address)) {
-            symbols.push_back(symbol);
-        }
+    if (Core::Get().isSymbolResolutionDeferred) {
+        symbolEngine->RegisterModules(std::vector<uint64>(addresses.begin(), addresses.end()));
+    }
+    else {
+        Core::Get().DumpProgress("Resolving Symbols...");
+        symbolEngine->GetSymbols(std::vector<uint64>(addresses.begin(), addresses.end()), symbols);
     }
 
     stream << symbols;
 
     tree.Serialize(stream);
 
+    // Per-scope trees: {DescriptionIndex, Tree}, the root invoke count is the number of samples in the scope
+    stream << (uint32)scopeTrees.size();
+    for (auto it = scopeTrees.begin(); it != scopeTrees.end(); ++it) {
+        EventDescription * description = const_cast<EventDescription *>(it->first);
+        EventDescriptionBoard::Get().RegisterDescription(description);
+
+        stream << description->index;
+        it->second.Serialize(stream);
+    }
+
     return stream;
 }
 
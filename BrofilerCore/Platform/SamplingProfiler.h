@@ -15,57 +15,46 @@ using CallStack = std::vector<uintptr_t>;
 
 ////////////////////////////////////////////////////////////
 //
-//    CallStackTreeNode
+//    CallStackTree
 //
 /////
 
-struct CallStackTreeNode {
-    uint64_t dwArddress  = 0;
-    uint32_t invokeCount = 0;
-
-    std::list<CallStackTreeNode> children;
-
-    CallStackTreeNode () { }
-
-    CallStackTreeNode(uint64_t address) : dwArddress(address) {
-    }
-
-    bool Merge (const CallStack & callstack, size_t index) {
-        ++invokeCount;
-        if (index == 0) {
-            return true;
-        }
-
-        // I suppose, that usually sampling function has only several children.. so linear search will be fast enough
-        uint64_t address = callstack[index];
-        for (auto it = children.begin(); it != children.end(); ++it) {
-            if (it->dwArddress == address) {
-                return it->Merge(callstack, index - 1);
-            }
-        }
-
-        // Didn't find node => create one
-        children.push_back(CallStackTreeNode(address));
-        return children.back().Merge(callstack, index - 1);
-    }
-
-    void CollectAddresses (std::unordered_set<uint64> & addresses) const {
-        addresses.insert(dwArddress);
-        for (auto it = children.begin(); it != children.end(); ++it) {
-            it->CollectAddresses(addresses);
-        }
-    }
-
-    OutputDataStream & Serialize (OutputDataStream & stream) const {
-        stream << (uint64)dwArddress << invokeCount;
-
-        stream << (uint32)children.size();
-        for (auto it = children.begin(); it != children.end(); ++it) {
-            it->Serialize(stream);
-        }
-
-        return stream;
-    }
+// Prefix tree of sampled callstacks, merged from the outermost frame.
+// Nodes live in a single vector and children are found through an open-addressing table keyed by (parent, address).
+class CallStackTree {
+public:
+    CallStackTree ();
+
+    // Frames are ordered from the innermost one, the innermost frame itself is not merged
+    void Merge (const CallStack & callstack);
+
+    // Unique addresses of all the nodes, collected while merging
+    const std::unordered_set<uint64> & GetAddresses () const { return addresses; }
+
+    OutputDataStream & Serialize (OutputDataStream & stream) const;
+
+private:
+    struct Node {
+        uint64_t address;
+        uint32_t parent;
+        uint32_t invokeCount;
+        uint32_t childCount;
+        uint32_t firstChild;
+        uint32_t lastChild;
+        uint32_t nextSibling;
+    };
+
+    enum : uint32_t { ROOT = 0 }; // Never a child, so it doubles as an empty slot / end of list marker
+
+    uint32_t FindOrAddChild (uint32_t parent, uint64_t address);
+    void Rehash (size_t capacity);
+
+    static size_t Hash (uint32_t parent, uint64_t address);
+
+    std::vector<Node>     nodes;
+    std::vector<uint32_t> table;
+
+    std::unordered_set<uint64> addresses;
 };
 
 
@@ -76,14 +65,16 @@ struct CallStackTreeNode {
 /////
 
 struct SamplingProfiler {
+    SamplingProfiler () : sampleCount(0) {}
+
     virtual bool IsSamplingScope () const = 0;
 
     virtual bool IsActive () const = 0;
 
-    virtual void StartSampling (const std::vector<ThreadEntry *> & threads, uint32_t samplingInterval = 300) = 0;
+    virtual void StartSampling (const std::vector<ThreadEntry *> & threads, const SamplingSettings & settings) = 0;
     virtual bool StopSampling () = 0;
 
-    virtual size_t GetCollectedCount () const = 0;
+    size_t GetCollectedCount () const { return sampleCount.Load(); }
 
     virtual ~SamplingProfiler () {};
     virtual OutputDataStream & Serialize (OutputDataStream & stream);
@@ -92,7 +83,21 @@ struct SamplingProfiler {
 
 protected:
 
-    std::list<CallStack> callstacks;
+    // Called from the sampling thread, returns false once the sample budget is spent.
+    // scope - innermost instrumented scope of the thread at the moment of the sample: EventStorage::GetCurrentScope for
+    // samplers which interrupt the thread, the replayed scope log for the ones which drain their data later
+    bool AddCallStack (uint64_t threadID, uint64_t timestamp, const EventDescription * scope, const uintptr_t * frames, uint32_t depth);
+    void ClearCallStacks ();
+
+    bool IsBudgetExhausted () const { return settings.sampleBudget != 0 && sampleCount.Load() >= settings.sampleBudget; }
+
+    SamplingSettings settings;
+
+    // Packed callstack list: {ThreadID, Timestamp, Scope, Depth, Frames[Depth]}
+    typedef MemoryPool<uint64, 1024 * 32> CallStackPool;
+    CallStackPool callstacks;
+
+    MT::Atomic32<uint32> sampleCount;
 };
 
 } // Brofiler
@@ -21,29 +21,99 @@ CaptureStatus::Type SchedulerTrace::Start(int mode, const ThreadList& threads, b
                     threadName = "Unknown";
                 }
 
-                ThreadDescription threadDesc(threadName, threadInfo.id, threadInfo.fromOtherProcess);
+                ThreadDescription threadDesc(threadName, threadInfo.id, threadInfo.id.AsUInt64(), threadInfo.fromOtherProcess);
                 Core::Get().RegisterThread(threadDesc, nullptr);
             }
+
+            // threads is the snapshot of Core, it has to see the new entries
+            Core::Get().RefreshThreads();
         }
 
         Core::Get().DumpProgress("Starting");
     }
 
     BRO_UNUSED(mode);
-    activeThreadsIDs.clear();
+    ThreadIdTable* table = new ThreadIdTable();
     for (auto it = threads.begin(); it != threads.end(); ++it) {
         ThreadEntry* entry = *it;
         if (entry->isAlive && !entry->description.fromOtherProcess) {
-            activeThreadsIDs.insert(std::make_pair(entry->description.threadID.AsUInt64(), entry));
+            // Tracers report kernel thread ids
+            table->Insert(entry->description.systemThreadId, entry);
         }
     }
 
+    Publish(table);
+
     return CaptureStatus::OK;
 }
 
 bool SchedulerTrace::Stop() {
-    activeThreadsIDs.clear();
+    ReleaseTables();
     return true;
 }
 
+SchedulerTrace::~SchedulerTrace() {
+    ReleaseTables();
+}
+
+void SchedulerTrace::AttachThreads(const ThreadList& threads) {
+    ThreadList added;
+    PublishThreads(threads, added);
+}
+
+void SchedulerTrace::PublishThreads(const ThreadList& threads, ThreadList& added) {
+    MT::ScopedGuard guard(tableLock);
+
+    const ThreadIdTable* current = activeThreadsIDs.load(std::memory_order_relaxed);
+    if (current == nullptr) {
+        return;
+    }
+
+    ThreadIdTable* table = nullptr;
+    for (auto it = threads.begin(); it != threads.end(); ++it) {
+        ThreadEntry* entry = *it;
+        if (!entry->isAlive || entry->description.fromOtherProcess || current->Find(entry->description.systemThreadId) != nullptr) {
+            continue;
+        }
+
+        if (table == nullptr) {
+            table = new ThreadIdTable(*current);
+        }
+
+        table->Insert(entry->description.systemThreadId, entry);
+        added.push_back(entry);
+    }
+
+    if (table != nullptr) {
+        retiredTables.push_back(activeThreadsIDs.load(std::memory_order_relaxed));
+        activeThreadsIDs.store(table, std::memory_order_release);
+    }
+}
+
+void SchedulerTrace::Publish(ThreadIdTable* table) {
+    MT::ScopedGuard guard(tableLock);
+
+    if (ThreadIdTable* current = activeThreadsIDs.load(std::memory_order_relaxed)) {
+        retiredTables.push_back(current);
+    }
+
+    activeThreadsIDs.store(table, std::memory_order_release);
+}
+
+void SchedulerTrace::ReleaseTables() {
+    MT::ScopedGuard guard(tableLock);
+
+    if (ThreadIdTable* current = activeThreadsIDs.load(std::memory_order_relaxed)) {
+        retiredTables.push_back(current);
+    }
+
+    activeThreadsIDs.store(nullptr, std::memory_order_release);
+
+    for (auto it = retiredTables.begin(); it != retiredTables.end(); ++it) {
+        delete *it;
+    }
+
+    retiredTables.clear();
+}
+
 }
\ No newline at end of file
@@ -1,7 +1,9 @@
 #pragma once
 #include "Core.h"
-#include <unordered_map>
 #include "ThreadsEnumerator.h"
+#include "ThreadIdTable.h"
+
+#include <atomic>
 
 
 namespace Brofiler {
@@ -17,17 +19,46 @@ struct SchedulerTrace {
         SWITCH_CONTEXTS = 1 << 0,
         STACK_WALK = 1 << 1,
         SYS_CALLS = 1 << 2,
+        WAKEUPS = 1 << 3,
         ALL = 0xFFFFFFFF
     };
 
     std::vector<Brofiler::ThreadInfo> allProcessThreads;
-    std::unordered_map<uint64, ThreadEntry *> activeThreadsIDs;
+
+    // Entry of a traced thread by its kernel id (ThreadDescription::systemThreadId), called from the tracer callbacks without a lock
+    BRO_FORCE_INLINE ThreadEntry * FindActiveThread (uint64 id) const {
+        const ThreadIdTable * table = activeThreadsIDs.load(std::memory_order_acquire);
+        return table != nullptr ? table->Find(id) : nullptr;
+    }
 
     virtual CaptureStatus::Type Start (int mode, const ThreadList & threads, bool autoAddUnknownThreads);
     virtual bool Stop ();
 
-    virtual ~SchedulerTrace () { };
+    // Called on thread registration and by Core::Update during a capture: publishes the threads registered after Start,
+    // tracers which trace thread by thread attach to them as well
+    virtual void AttachThreads (const ThreadList & threads);
+
+    virtual ~SchedulerTrace ();
     static SchedulerTrace * Get ();
+
+protected:
+
+    // Current table, nullptr if there is no trace
+    const ThreadIdTable * GetActiveThreads () const { return activeThreadsIDs.load(std::memory_order_acquire); }
+
+    // Publishes a copy of the table with the alive threads it lacks, the new entries are appended to added
+    void PublishThreads (const ThreadList & threads, ThreadList & added);
+
+private:
+
+    // A published table is never modified: a new thread gets a rebuilt copy, the replaced ones are freed by Stop,
+    // when no callback can be reading them
+    std::atomic<ThreadIdTable *> activeThreadsIDs { nullptr };
+    std::vector<ThreadIdTable *> retiredTables;
+    MT::Mutex                    tableLock;
+
+    void Publish (ThreadIdTable * table);
+    void ReleaseTables ();
 };
 
 } // Brofiler
@@ -1,5 +1,19 @@
 #include "SymbolEngine.h"
 
+#include <algorithm>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 namespace Brofiler {
 
 ////////////////////////////////////////////////////////////
@@ -13,4 +27,440 @@ OutputDataStream & operator<< (OutputDataStream & os, const Symbol * const symbo
     return os << symbol->address << symbol->module << symbol->function << symbol->file << symbol->line;
 }
 
+
+////////////////////////////////////////////////////////////
+//
+//    SymbolModule
+//
+/////
+
+OutputDataStream & operator<< (OutputDataStream & os, const SymbolModule & module) {
+    return os << module.base << module.size << module.path << module.buildId;
+}
+
+
+////////////////////////////////////////////////////////////
+//
+//    SymbolFileCache
+//
+/////
+
+// One file per module build id: {Header, Record*}. Records are appended after every capture,
+// a truncated tail (e.g. a crash while writing) is ignored on load.
+// Record: {uint64 ModuleOffset, uint64 SymbolOffset, uint32 Line, uint32 FunctionLength, wchar_t Function[], uint32 FileLength, wchar_t File[]}
+namespace SymbolFileCache {
+
+static const uint32_t MAGIC   = 0x4D595342; // 'BSYM'
+static const uint32_t VERSION = 1;
+
+// Keyed by offset from the module base: stays valid when the module is loaded at another address
+using Entries = std::unordered_map<uint64, Symbol>;
+
+#ifndef _WIN32
+// Cached symbols are shown to the user as is: files someone else could have planted or modified are not trusted
+static bool IsPrivate (const struct stat & info) {
+    return info.st_uid == getuid() && (info.st_mode & (S_IWGRP | S_IWOTH)) == 0;
+}
+#endif
+
+// Per-user location: %LOCALAPPDATA% on Windows, $XDG_CACHE_HOME or $HOME/.cache elsewhere
+static std::string GetDirectory () {
+#ifdef _WIN32
+    std::string directory;
+
+    // BROFILER_SYMBOL_CACHE="" disables the cache
+    if (const char * path = getenv("BROFILER_SYMBOL_CACHE")) {
+        directory = path;
+    }
+    else if (const char * localAppData = getenv("LOCALAPPDATA")) {
+        directory = std::string(localAppData) + "\\Brofiler";
+        _mkdir(directory.c_str());
+        directory += "\\Symbols";
+    }
+
+    if (!directory.empty())
+        _mkdir(directory.c_str());
+#else
+    std::string directory;
+
+    // BROFILER_SYMBOL_CACHE="" disables the cache
+    if (const char * path = getenv("BROFILER_SYMBOL_CACHE")) {
+        directory = path;
+    }
+    else {
+        const char * cache = getenv("XDG_CACHE_HOME");
+        const char * home = getenv("HOME");
+
+        if (cache && cache[0] == '/') {
+            directory = cache;
+        }
+        else if (home && home[0] == '/') {
+            directory = std::string(home) + "/.cache";
+        }
+        else {
+            return std::string();
+        }
+
+        mkdir(directory.c_str(), 0700);
+        directory += "/brofiler-symbols";
+    }
+
+    if (directory.empty())
+        return directory;
+
+    mkdir(directory.c_str(), 0700);
+
+    // A directory which isn't ours (or is writable by others) disables the cache
+    struct stat info;
+    if (lstat(directory.c_str(), &info) != 0 || !S_ISDIR(info.st_mode) || !IsPrivate(info))
+        return std::string();
+#endif
+
+    return directory;
+}
+
+// Refuses symlinks and files which fail the ownership check, new files are created private to the user
+static FILE * OpenFile (const std::string & path, bool append) {
+#ifdef _WIN32
+    return fopen(path.c_str(), append ? "ab" : "rb");
+#else
+    int descriptor = append ? open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_NOFOLLOW | O_CLOEXEC, 0600)
+                            : open(path.c_str(), O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+    if (descriptor < 0)
+        return nullptr;
+
+    struct stat info;
+    if (fstat(descriptor, &info) != 0 || !S_ISREG(info.st_mode) || !IsPrivate(info)) {
+        close(descriptor);
+        return nullptr;
+    }
+
+    FILE * file = fdopen(descriptor, append ? "ab" : "rb");
+    if (!file)
+        close(descriptor);
+
+    return file;
+#endif
+}
+
+static std::string GetPath (const std::string & buildId) {
+    static const std::string directory = GetDirectory();
+    if (directory.empty())
+        return std::string();
+
+    return directory + "/" + buildId + ".bsym";
+}
+
+static bool ReadString (FILE * file, std::wstring & str) {
+    uint32_t length = 0;
+    if (fread(&length, sizeof(length), 1, file) != 1 || length > 64 * 1024)
+        return false;
+
+    str.resize(length);
+    return length == 0 || fread(&str[0], sizeof(wchar_t), length, file) == length;
+}
+
+static void WriteString (FILE * file, const std::wstring & str) {
+    uint32_t length = (uint32_t)str.size();
+    fwrite(&length, sizeof(length), 1, file);
+    fwrite(str.c_str(), sizeof(wchar_t), length, file);
+}
+
+static void Load (const std::string & buildId, Entries & entries) {
+    std::string path = GetPath(buildId);
+    if (path.empty())
+        return;
+
+    FILE * file = OpenFile(path, false);
+    if (!file)
+        return;
+
+    uint32_t header[3] = { 0 };
+    if (fread(header, sizeof(header), 1, file) == 1 && header[0] == MAGIC && header[1] == VERSION && header[2] == sizeof(wchar_t)) {
+        for (;;) {
+            uint64_t moduleOffset = 0;
+            Symbol symbol;
+
+            if (fread(&moduleOffset, sizeof(moduleOffset), 1, file) != 1
+                || fread(&symbol.offset, sizeof(symbol.offset), 1, file) != 1
+                || fread(&symbol.line, sizeof(symbol.line), 1, file) != 1
+                || !ReadString(file, symbol.function)
+                || !ReadString(file, symbol.file))
+                break;
+
+            entries[moduleOffset] = std::move(symbol);
+        }
+    }
+
+    fclose(file);
+}
+
+static void Save (const SymbolModule & module, const std::vector<const Symbol *> & symbols) {
+    std::string path = GetPath(module.buildId);
+    if (path.empty())
+        return;
+
+    FILE * file = OpenFile(path, true);
+    if (!file)
+        return;
+
+    fseek(file, 0, SEEK_END);
+    if (ftell(file) == 0) {
+        uint32_t header[3] = { MAGIC, VERSION, (uint32_t)sizeof(wchar_t) };
+        fwrite(header, sizeof(header), 1, file);
+    }
+
+    for (const Symbol * symbol : symbols) {
+        uint64_t moduleOffset = symbol->address - module.base;
+        fwrite(&moduleOffset, sizeof(moduleOffset), 1, file);
+        fwrite(&symbol->offset, sizeof(symbol->offset), 1, file);
+        fwrite(&symbol->line, sizeof(symbol->line), 1, file);
+        WriteString(file, symbol->function);
+        WriteString(file, symbol->file);
+    }
+
+    fclose(file);
+}
+
+} // SymbolFileCache
+
+
+////////////////////////////////////////////////////////////
+//
+//    SymbolEngine
+//
+/////
+
+static const size_t INVALID_MODULE = (size_t)-1;
+
+struct SymbolEngine::ResolveJob {
+    enum : uint32_t {
+        BATCH_SIZE  = 256,
+        MAX_WORKERS = 8,
+    };
+
+    const std::vector<PendingSymbol> * pending;
+    std::vector<Symbol> *              resolved;
+    SymbolEngine *                     engine;
+
+    MT::Atomic32<uint32> nextBatch;
+    MT::Atomic32<uint32> resolvedCount;
+
+    ResolveJob (SymbolEngine * _engine, const std::vector<PendingSymbol> & _pending, std::vector<Symbol> & _resolved)
+        : pending(&_pending)
+        , resolved(&_resolved)
+        , engine(_engine)
+        , nextBatch(0)
+        , resolvedCount(0)
+    {
+    }
+};
+
+const Symbol * const SymbolEngine::GetSymbol (uint64_t address) {
+    if (address == 0)
+        return nullptr;
+
+    SymbolCache::iterator it = cache.find(address);
+    if (it != cache.end())
+        return &it->second;
+
+    Symbol symbol;
+    if (!ResolveSymbol(address, symbol))
+        return nullptr;
+
+    Symbol & result = cache[address];
+    result = std::move(symbol);
+    return &result;
+}
+
+size_t SymbolEngine::FindModule (uint64_t address) {
+    for (size_t i = 0; i < modules.size(); ++i) {
+        if (modules[i].base <= address && address < modules[i].base + modules[i].size)
+            return i;
+    }
+
+    SymbolModule module;
+    if (!GetModule(address, module) || module.size == 0)
+        return INVALID_MODULE;
+
+    modules.push_back(std::move(module));
+    return modules.size() - 1;
+}
+
+bool SymbolEngine::ResolveBatch (ResolveJob & job) {
+    const size_t count = job.pending->size();
+
+    size_t begin = (size_t)(job.nextBatch.IncFetch() - 1) * ResolveJob::BATCH_SIZE;
+    if (begin >= count)
+        return false;
+
+    size_t end = std::min(begin + ResolveJob::BATCH_SIZE, count);
+    for (size_t i = begin; i < end; ++i) {
+        uint64_t address = (*job.pending)[i].address;
+        Symbol & symbol = (*job.resolved)[i];
+
+        // Failed lookups keep a zero address and are not cached
+        if (!ResolveSymbol(address, symbol)) {
+            symbol.address = 0;
+        }
+    }
+
+    job.resolvedCount.AddFetch((uint32)(end - begin));
+    return true;
+}
+
+void SymbolEngine::AsyncResolve (void * _job) {
+    ResolveJob & job = *(ResolveJob *)_job;
+    while (job.engine->ResolveBatch(job)) {}
+}
+
+void SymbolEngine::ResolvePending (const std::vector<PendingSymbol> & pending, std::vector<Symbol> & resolved) {
+    resolved.resize(pending.size());
+
+    ResolveJob job(this, pending, resolved);
+
+    MT::Thread workers[ResolveJob::MAX_WORKERS];
+    uint32 workerCount = 0;
+
+    if (IsThreadSafe() && pending.size() > ResolveJob::BATCH_SIZE) {
+        uint32 hardwareThreads = (uint32)MT::Thread::GetNumberOfHardwareThreads();
+        uint32 batchCount = (uint32)((pending.size() + ResolveJob::BATCH_SIZE - 1) / ResolveJob::BATCH_SIZE);
+
+        // The calling thread resolves batches as well
+        workerCount = std::min(std::min(hardwareThreads, batchCount), (uint32)ResolveJob::MAX_WORKERS) - 1;
+        for (uint32 i = 0; i < workerCount; ++i) {
+            workers[i].Start(256 * 1024, &SymbolEngine::AsyncResolve, &job);
+        }
+    }
+
+    // One progress message per ~100ms instead of one per address
+    int64 lastReportTime = MT::GetTimeMilliSeconds();
+    std::stringstream msg;
+
+    while (ResolveBatch(job)) {
+        int64 time = MT::GetTimeMilliSeconds();
+        if (time - lastReportTime >= 100) {
+            lastReportTime = time;
+
+            msg.str("");
+            msg << "Resolving symbols " << job.resolvedCount.Load() << " of " << (uint32)pending.size() << std::endl;
+            Core::Get().DumpProgress(msg.str().c_str());
+        }
+    }
+
+    for (uint32 i = 0; i < workerCount; ++i) {
+        workers[i].Join();
+    }
+}
+
+void SymbolEngine::RegisterModules (const std::vector<uint64> & addresses) {
+    for (uint64 address : addresses) {
+        if (address == 0)
+            continue;
+
+        size_t module = FindModule(address);
+        if (module == INVALID_MODULE)
+            continue;
+
+        if (module >= referencedModules.size())
+            referencedModules.resize(modules.size(), false);
+
+        referencedModules[module] = true;
+    }
+}
+
+std::vector<SymbolModule> SymbolEngine::GetReferencedModules () const {
+    std::vector<SymbolModule> result;
+
+    for (size_t i = 0; i < referencedModules.size(); ++i) {
+        if (referencedModules[i]) {
+            result.push_back(modules[i]);
+        }
+    }
+
+    return result;
+}
+
+void SymbolEngine::ResetReferencedModules () {
+    referencedModules.clear();
+}
+
+void SymbolEngine::GetSymbols (const std::vector<uint64> & addresses, std::vector<const Symbol *> & symbols) {
+    symbols.reserve(symbols.size() + addresses.size());
+
+    std::vector<PendingSymbol> pending;
+
+    for (uint64 address : addresses) {
+        if (address == 0)
+            continue;
+
+        SymbolCache::iterator it = cache.find(address);
+        if (it != cache.end()) {
+            symbols.push_back(&it->second);
+        }
+        else {
+            PendingSymbol symbol = { address, FindModule(address) };
+            pending.push_back(symbol);
+        }
+    }
+
+    if (pending.empty())
+        return;
+
+    // On-disk cache, every module file is loaded once per batch
+    std::unordered_map<size_t, SymbolFileCache::Entries> fileEntries;
+    std::vector<PendingSymbol> unresolved;
+
+    for (const PendingSymbol & symbol : pending) {
+        if (symbol.module != INVALID_MODULE && !modules[symbol.module].buildId.empty()) {
+            const SymbolModule & module = modules[symbol.module];
+
+            auto entries = fileEntries.find(symbol.module);
+            if (entries == fileEntries.end()) {
+                entries = fileEntries.emplace(symbol.module, SymbolFileCache::Entries()).first;
+                SymbolFileCache::Load(module.buildId, entries->second);
+            }
+
+            auto entry = entries->second.find(symbol.address - module.base);
+            if (entry != entries->second.end()) {
+                Symbol & result = cache[symbol.address];
+                result = entry->second;
+                result.address = symbol.address;
+                result.module = module.path;
+                symbols.push_back(&result);
+                continue;
+            }
+        }
+
+        unresolved.push_back(symbol);
+    }
+
+    if (unresolved.empty())
+        return;
+
+    std::vector<Symbol> resolved;
+    ResolvePending(unresolved, resolved);
+
+    std::unordered_map<size_t, std::vector<const Symbol *>> fileUpdates;
+
+    for (size_t i = 0; i < unresolved.size(); ++i) {
+        if (resolved[i].address == 0)
+            continue;
+
+        Symbol & result = cache[unresolved[i].address];
+        result = std::move(resolved[i]);
+        symbols.push_back(&result);
+
+        // Unnamed symbols are not persisted: the debug info might show up next time
+        size_t module = unresolved[i].module;
+        if (module != INVALID_MODULE && !modules[module].buildId.empty() && !result.function.empty()) {
+            fileUpdates[module].push_back(&result);
+        }
+    }
+
+    for (auto it = fileUpdates.begin(); it != fileUpdates.end(); ++it) {
+        SymbolFileCache::Save(modules[it->first], it->second);
+    }
+}
+
 } // Brofiler
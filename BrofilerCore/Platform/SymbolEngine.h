@@ -1,6 +1,8 @@
 #pragma once
 #include "Core.h"
+#include <string>
 #include <unordered_map>
+#include <vector>
 
 namespace Brofiler {
 
@@ -22,6 +24,22 @@ struct Symbol {
 OutputDataStream & operator<< (OutputDataStream & os, const Symbol * const symbol);
 
 
+////////////////////////////////////////////////////////////
+//
+//    SymbolModule
+//
+/////
+
+struct SymbolModule {
+    uint64_t     base = 0;
+    uint64_t     size = 0;
+    std::wstring path;
+    std::string  buildId; // Stable identity of the binary, symbols of modules without one are not persisted
+};
+
+OutputDataStream & operator<< (OutputDataStream & os, const SymbolModule & module);
+
+
 ////////////////////////////////////////////////////////////
 //
 //    SymbolEngine
@@ -30,7 +48,17 @@ OutputDataStream & operator<< (OutputDataStream & os, const Symbol * const symbo
 
 struct SymbolEngine {
     // Get Symbol from address
-    virtual const Symbol * const GetSymbol (uint64_t dwAddress) = 0;
+    const Symbol * const GetSymbol (uint64_t address);
+
+    // Resolves a batch of unique addresses: the on-disk cache is consulted first, the rest goes to the platform engine
+    void GetSymbols (const std::vector<uint64> & addresses, std::vector<const Symbol *> & symbols);
+
+    // Deferred symbolization: only looks up the modules which contain the addresses and marks them as referenced
+    void RegisterModules (const std::vector<uint64> & addresses);
+
+    // Modules referenced since the last ResetReferencedModules (called on every capture start)
+    std::vector<SymbolModule> GetReferencedModules () const;
+    void ResetReferencedModules ();
 
     virtual ~SymbolEngine () {};
 
@@ -38,8 +66,36 @@ struct SymbolEngine {
 
 protected:
 
+    // Platform lookup for an address which is not cached yet, returns false if the engine is not usable
+    virtual bool ResolveSymbol (uint64_t address, Symbol & symbol) = 0;
+
+    // Module which contains the address
+    virtual bool GetModule (uint64_t address, SymbolModule & module) = 0;
+
+    // Whether ResolveSymbol may be called from several threads at the same time
+    virtual bool IsThreadSafe () const { return false; }
+
     using SymbolCache = std::unordered_map<uint64, Symbol>;
     SymbolCache cache;
+
+private:
+
+    struct PendingSymbol {
+        uint64_t address;
+        size_t   module;
+    };
+
+    struct ResolveJob;
+
+    std::vector<SymbolModule> modules;           // Lookup cache, lives as long as the engine
+    std::vector<bool>         referencedModules; // Indexed as modules
+
+    size_t FindModule (uint64_t address);
+    void ResolvePending (const std::vector<PendingSymbol> & pending, std::vector<Symbol> & resolved);
+    bool ResolveBatch (ResolveJob & job);
+
+    // Called from worker thread
+    static void AsyncResolve (void * job);
 };
 
 } // Brofiler
@@ -0,0 +1,109 @@
+#pragma once
+#include "Common.h"
+#include <vector>
+
+namespace Brofiler {
+
+////////////////////////////////////////////////////////////
+//
+//    Forward Declarations
+//
+/////
+
+struct ThreadEntry;
+
+
+////////////////////////////////////////////////////////////
+//
+//    ThreadIdTable
+//
+/////
+
+// Kernel thread id => ThreadEntry, queried for every context switch on the machine.
+// A published table is never modified (SchedulerTrace swaps in a rebuilt copy), so lookups are plain reads of two flat arrays:
+// the load factor is kept at 1/4 or below, so a miss (threads of other processes) usually stops at the first probe.
+class ThreadIdTable {
+public:
+
+    ThreadIdTable () : mask(0), count(0) {}
+
+    void Clear () {
+        keys.clear();
+        values.clear();
+        mask = 0;
+        count = 0;
+    }
+
+    // Id 0 is the idle thread and is never stored
+    void Insert (uint64 id, ThreadEntry * entry) {
+        if (id == 0)
+            return;
+
+        if ((count + 1) * 4 > keys.size())
+            Rehash(keys.empty() ? 64 : keys.size() * 2);
+
+        size_t slot = GetSlot(id);
+        while (keys[slot] != 0 && keys[slot] != id)
+            slot = (slot + 1) & mask;
+
+        if (keys[slot] == 0)
+            ++count;
+
+        keys[slot] = id;
+        values[slot] = entry;
+    }
+
+    BRO_FORCE_INLINE ThreadEntry * Find (uint64 id) const {
+        if (count == 0 || id == 0)
+            return nullptr;
+
+        for (size_t slot = GetSlot(id); keys[slot] != 0; slot = (slot + 1) & mask) {
+            if (keys[slot] == id)
+                return values[slot];
+        }
+
+        return nullptr;
+    }
+
+    size_t Size () const { return count; }
+
+    // func(uint64 id, ThreadEntry * entry)
+    template<class Func>
+    void ForEach (Func func) const {
+        for (size_t slot = 0; slot < keys.size(); ++slot) {
+            if (keys[slot] != 0)
+                func(keys[slot], values[slot]);
+        }
+    }
+
+private:
+
+    std::vector<uint64>        keys; // 0 marks an empty slot
+    std::vector<ThreadEntry *> values;
+    size_t                     mask;
+    size_t                     count;
+
+    BRO_FORCE_INLINE size_t GetSlot (uint64 id) const {
+        // Windows thread ids are multiples of 4: spread them with a multiplicative hash
+        return (size_t)((id * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+    }
+
+    void Rehash (size_t capacity) {
+        std::vector<uint64> oldKeys;
+        std::vector<ThreadEntry *> oldValues;
+        oldKeys.swap(keys);
+        oldValues.swap(values);
+
+        keys.assign(capacity, 0);
+        values.assign(capacity, nullptr);
+        mask = capacity - 1;
+        count = 0;
+
+        for (size_t slot = 0; slot < oldKeys.size(); ++slot) {
+            if (oldKeys[slot] != 0)
+                Insert(oldKeys[slot], oldValues[slot]);
+        }
+    }
+};
+
+} // Brofiler
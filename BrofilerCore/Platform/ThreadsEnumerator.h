@@ -12,6 +12,8 @@ namespace Brofiler {
 //
 /////
 
+// Windows thread handles are plain ids, POSIX ones can't be built from a system thread id
+#if MT_PLATFORM_WINDOWS
 struct ThreadIdExt : public MT::ThreadId {
 
     ThreadIdExt (uint32_t _id) {
@@ -20,6 +22,7 @@ struct ThreadIdExt : public MT::ThreadId {
     }
 
 };
+#endif
 
 
 ////////////////////////////////////////////////////////////
@@ -29,22 +32,23 @@ struct ThreadIdExt : public MT::ThreadId {
 /////
 
 struct ThreadInfo {
-    std::string name;
-    ThreadIdExt id;
-    bool        fromOtherProcess;
+    std::string  name;
+    MT::ThreadId id;
+    bool         fromOtherProcess;
 
     ThreadInfo ()
-        : id(0)
-        , fromOtherProcess(false)
+        : fromOtherProcess(false)
     {
     }
 
+#if MT_PLATFORM_WINDOWS
     ThreadInfo (uint32_t _id, const char * _name, bool fromOtherProcess)
         : name(_name)
-        , id(_id)
+        , id(ThreadIdExt(_id))
         , fromOtherProcess(fromOtherProcess)
     {
     }
+#endif
 };
 
 
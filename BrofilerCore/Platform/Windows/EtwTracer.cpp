@@ -108,6 +108,32 @@ struct CSwitch {
 };
 
 
+////////////////////////////////////////////////////////////
+//
+//    ReadyThread
+//
+/////
+
+struct ReadyThread {
+    // The thread identifier of the thread being readied for execution.
+    uint32_t TThreadId;
+
+    // The reason for the priority boost.
+    int8_t  AdjustReason;
+
+    // The value by which the priority is being adjusted.
+    int8_t  AdjustIncrement;
+
+    // The flags: 0x1 - the thread has been readied from DPC (deferred procedure call).
+    int8_t  Flag;
+
+    // Reserved.
+    int8_t  Reserved;
+
+    static const uint8_t OPCODE = 50;
+};
+
+
 ////////////////////////////////////////////////////////////
 //
 //    StackWalk_Event
@@ -203,7 +229,8 @@ static DWORD currentProcessId = 0;
 /////
 
 void WINAPI OnRecordEvent (PEVENT_RECORD eventRecord) {
-    static uint8_t cpuCoreIsExecutingThreadFromOurProcess[256] = { 0 };
+    // Thread of our process which is running on the physical core, 0 - none
+    static uint64 cpuCoreExecutingThreadFromOurProcess[256] = { 0 };
 
     const uint8_t opcode = eventRecord->EventHeader.EventDescriptor.Opcode;
 
@@ -220,16 +247,28 @@ void WINAPI OnRecordEvent (PEVENT_RECORD eventRecord) {
             SwitchContextResult res = Core::Get().ReportSwitchContext(desc);
 
             // track physical cpu cores used by our process
-            if (res == SCR_THREADENABLED) {
-                cpuCoreIsExecutingThreadFromOurProcess[desc.cpuId] = 1;
+            if (res == SCR_THREADENABLED || res == SCR_INSIDEPROCESS) {
+                cpuCoreExecutingThreadFromOurProcess[desc.cpuId] = desc.newThreadId;
             }
 
             if (res == SCR_THREADDISABLED) {
-                cpuCoreIsExecutingThreadFromOurProcess[desc.cpuId] = 0;
+                cpuCoreExecutingThreadFromOurProcess[desc.cpuId] = 0;
             }
         }
 
     }
+    else if (opcode == ReadyThread::OPCODE && IsEqualGUID(eventRecord->EventHeader.ProviderId, CSwitchProfileGuid)) {
+        if (eventRecord->UserDataLength >= sizeof(ReadyThread)) {
+            ReadyThread* pReadyEvent = (ReadyThread*)eventRecord->UserData;
+
+            // The event is logged in the context of the thread which made the other one ready
+            Brofiler::WakeupDesc desc;
+            desc.timestamp = eventRecord->EventHeader.TimeStamp.QuadPart;
+            desc.wakerThreadId = (pReadyEvent->Flag & 0x1) ? 0 : (uint64)eventRecord->EventHeader.ThreadId;
+            desc.wokenThreadId = (uint64)pReadyEvent->TThreadId;
+            Core::Get().ReportWakeup(desc);
+        }
+    }
     else if (opcode == StackWalk_Event::OPCODE) {
         if (eventRecord->UserData && eventRecord->UserDataLength >= sizeof(StackWalk_Event)) {
             //TODO: Support x86 windows kernels
@@ -262,19 +301,30 @@ void WINAPI OnRecordEvent (PEVENT_RECORD eventRecord) {
             uint8_t cpuId = eventRecord->BufferContext.ProcessorNumber;
 
             // report event, but only if our process working on this physical core
-            if (cpuCoreIsExecutingThreadFromOurProcess[cpuId]) {
+            if (uint64 threadId = cpuCoreExecutingThreadFromOurProcess[cpuId]) {
                 SysCallEnter* pEventEnter = (SysCallEnter*)eventRecord->UserData;
 
                 SysCallDesc desc;
                 desc.timestamp = eventRecord->EventHeader.TimeStamp.QuadPart;
                 desc.id = pEventEnter->SysCallAddress;
+                desc.threadId = threadId;
+                desc.type = SysCallDesc::ENTER;
                 Core::Get().ReportSysCall(desc);
             }
         }
     }
     else if (opcode == SysCallExit::OPCODE) {
-        SysCallExit* pEventExit = (SysCallExit*)eventRecord->UserData;
-        BRO_UNUSED(pEventExit);
+        uint8_t cpuId = eventRecord->BufferContext.ProcessorNumber;
+
+        // The exit carries only NTSTATUS: it is paired with the last enter of the thread
+        if (uint64 threadId = cpuCoreExecutingThreadFromOurProcess[cpuId]) {
+            SysCallDesc desc;
+            desc.timestamp = eventRecord->EventHeader.TimeStamp.QuadPart;
+            desc.id = 0;
+            desc.threadId = threadId;
+            desc.type = SysCallDesc::EXIT;
+            Core::Get().ReportSysCall(desc);
+        }
     }
 }
 
@@ -336,6 +386,10 @@ CaptureStatus::Type ETW::Start (int mode, const ThreadList & threads, bool autoA
             traceProperties->EnableFlags |= EVENT_TRACE_FLAG_SYSTEMCALL;
         }
 
+        if (mode & WAKEUPS) {
+            traceProperties->EnableFlags |= EVENT_TRACE_FLAG_DISPATCHER;
+        }
+
         traceProperties->LogFileMode = EVENT_TRACE_REAL_TIME_MODE;
         traceProperties->Wnode.Flags = WNODE_FLAG_TRACED_GUID;
         //
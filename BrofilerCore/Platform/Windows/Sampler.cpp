@@ -22,6 +22,19 @@ static void ClearStackContext (CONTEXT & context) {
     context.ContextFlags = CONTEXT_FULL;
 }
 
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+// High resolution timers (Windows 10 1803+) are not bound to the system timer tick
+static HANDLE CreateSamplingTimer () {
+    HANDLE timer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+    if (timer == NULL)
+        timer = CreateWaitableTimerExW(NULL, NULL, 0, TIMER_ALL_ACCESS);
+
+    return timer;
+}
+
 
 ////////////////////////////////////////////////////////////
 //
@@ -32,7 +45,6 @@ static void ClearStackContext (CONTEXT & context) {
 Sampler::Sampler ()
     : workerThread(nullptr)
     , finishEvent(nullptr)
-    , intervalMicroSeconds(300)
 {
 }
 
@@ -40,14 +52,14 @@ Sampler::~Sampler () {
     StopSampling();
 }
 
-void Sampler::StartSampling (const std::vector<ThreadEntry *> & threads, uint32_t samplingInterval) {
-    intervalMicroSeconds = samplingInterval;
-    targetThreads = threads;
-
+void Sampler::StartSampling (const std::vector<ThreadEntry *> & threads, const SamplingSettings & samplingSettings) {
     if (IsActive())
         StopSampling();
 
-    callstacks.clear();
+    settings = samplingSettings;
+    targetThreads = threads;
+
+    ClearCallStacks();
 
     BRO_VERIFY(finishEvent == nullptr && workerThread == nullptr, "Can't start sampling!", return);
 
@@ -107,8 +119,26 @@ DWORD WINAPI Sampler::AsyncUpdate (LPVOID lpParam) {
 
     ClearStackContext(context);
 
-    while (WaitForSingleObject(sampler.finishEvent, 0) == WAIT_TIMEOUT) {
-        MT::SpinSleepMicroSeconds(sampler.intervalMicroSeconds);
+    HANDLE timer = CreateSamplingTimer();
+    if (timer == NULL) {
+        for (const auto & entry : openThreads)
+            CloseHandle(entry.first);
+
+        return 0;
+    }
+
+    // Relative due time in 100ns units
+    LARGE_INTEGER dueTime;
+    dueTime.QuadPart = -(LONGLONG)sampler.settings.intervalMicroSeconds * 10;
+
+    HANDLE waitHandles[] = { sampler.finishEvent, timer };
+
+    while (!sampler.IsBudgetExhausted()) {
+        // One-shot timer re-armed every iteration: periodic timers have millisecond granularity
+        SetWaitableTimer(timer, &dueTime, 0, NULL, NULL, FALSE);
+
+        if (WaitForMultipleObjects(2, waitHandles, FALSE, INFINITE) != WAIT_OBJECT_0 + 1)
+            break;
 
         // Check whether we are inside sampling scope
         for (const auto & entry : openThreads) {
@@ -121,12 +151,14 @@ DWORD WINAPI Sampler::AsyncUpdate (LPVOID lpParam) {
                 continue;
 
             uint32_t count = 0;
+            const EventDescription * scope = nullptr;
 
             DWORD suspendedStatus = SuspendThread(handle);
 
             if (suspendedStatus != (DWORD)-1) {
                 // Check scope again because it is possible to leave sampling scope while trying to suspend main thread
                 if (storage->isSampling.Load() && GetThreadContext(handle, &context)) {
+                    scope = storage->GetCurrentScope();
                     count = GetCallstack(handle, context, buffer);
                 }
 
@@ -135,13 +167,15 @@ DWORD WINAPI Sampler::AsyncUpdate (LPVOID lpParam) {
             }
 
             if (count > 0) {
-                sampler.callstacks.push_back(CallStack(buffer.begin(), buffer.begin() + count));
+                sampler.AddCallStack(thread->description.threadID.AsUInt64(), (uint64_t)GetHighPrecisionTime(), scope, buffer.data(), count);
             }
 
             ClearStackContext(context);
         }
     }
 
+    CloseHandle(timer);
+
     for (const auto & entry : openThreads)
         CloseHandle(entry.first);
 
@@ -213,10 +247,6 @@ bool Sampler::IsSamplingScope () const {
     return false;
 }
 
-size_t Sampler::GetCollectedCount () const {
-    return callstacks.size();
-}
-
 SamplingProfiler * SamplingProfiler::Get () {
     static Sampler winSamplingProfiler;
     return &winSamplingProfiler;
@@ -33,11 +33,9 @@ public:
     bool IsSamplingScope() const override;
     bool IsActive() const override;
 
-    void StartSampling (const std::vector<ThreadEntry *> & threads, uint32_t samplingInterval) override;
+    void StartSampling (const std::vector<ThreadEntry *> & threads, const SamplingSettings & samplingSettings) override;
     bool StopSampling () override;
 
-    size_t GetCollectedCount () const override;
-
     static uint32_t GetCallstack (MW_HANDLE hThread, MW_CONTEXT & context, CallStackBuffer & callstack);
 
 private:
@@ -47,8 +45,6 @@ private:
     MW_HANDLE workerThread;
     MW_HANDLE finishEvent;
 
-    uint32_t intervalMicroSeconds;
-
     // Called from worker thread
     static MW_DWORD MW_WINAPI AsyncUpdate(void* lpParam);
 };
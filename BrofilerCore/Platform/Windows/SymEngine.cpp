@@ -25,19 +25,11 @@ SymEngine::~SymEngine () {
     Close();
 }
 
-const Symbol * const SymEngine::GetSymbol (uint64_t address) {
-    if (address == 0)
-        return nullptr;
-
+bool SymEngine::ResolveSymbol (uint64_t address, Symbol & symbol) {
     Init();
 
-    Symbol & symbol = cache[address];
-
-    if (symbol.address != 0)
-        return &symbol;
-
     if (!isInitialized)
-        return nullptr;
+        return false;
 
     symbol.address = address;
 
@@ -78,7 +70,40 @@ const Symbol * const SymEngine::GetSymbol (uint64_t address) {
 
     symbol.offset = static_cast<uintptr_t>(offset);
 
-    return &symbol;
+    return true;
+}
+
+bool SymEngine::GetModule (uint64_t address, SymbolModule & module) {
+    Init();
+
+    if (!isInitialized)
+        return false;
+
+    IMAGEHLP_MODULEW64 moduleInfo;
+    memset(&moduleInfo, 0, sizeof(IMAGEHLP_MODULEW64));
+    moduleInfo.SizeOfStruct = sizeof(moduleInfo);
+    if (!SymGetModuleInfoW64(hProcess, static_cast<DWORD64>(address), &moduleInfo))
+        return false;
+
+    module.base = moduleInfo.BaseOfImage;
+    module.size = moduleInfo.ImageSize;
+    module.path = moduleInfo.ImageName;
+
+    // Symbol server identity: PDB signature and age, image timestamp and size if there is no PDB
+    char buildId[64];
+    const GUID & guid = moduleInfo.PdbSig70;
+    if (guid.Data1 != 0 || guid.Data2 != 0 || guid.Data3 != 0) {
+        sprintf_s(buildId, "%08X%04X%04X%02X%02X%02X%02X%02X%02X%02X%02X%X",
+                  guid.Data1, guid.Data2, guid.Data3,
+                  guid.Data4[0], guid.Data4[1], guid.Data4[2], guid.Data4[3], guid.Data4[4], guid.Data4[5], guid.Data4[6], guid.Data4[7],
+                  moduleInfo.PdbAge);
+    }
+    else {
+        sprintf_s(buildId, "%08X%X", moduleInfo.TimeDateStamp, moduleInfo.ImageSize);
+    }
+
+    module.buildId = buildId;
+    return true;
 }
 
 void SymEngine::Init () {
@@ -33,8 +33,11 @@ public:
     void Init();
     void Close();
 
-    // Get Symbol from PDB file
-    const Symbol * const GetSymbol (uint64_t dwAddress) override;
+protected:
+
+    // Get Symbol from PDB file, DbgHelp is single threaded
+    bool ResolveSymbol (uint64_t address, Symbol & symbol) override;
+    bool GetModule (uint64_t address, SymbolModule & module) override;
 
 private:
 
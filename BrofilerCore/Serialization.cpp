@@ -51,6 +51,11 @@ OutputDataStream & operator<< (OutputDataStream & stream, uint8_t val) {
     return stream;
 }
 
+OutputDataStream & operator<< (OutputDataStream & stream, double val) {
+    stream.write((char*)&val, sizeof(double));
+    return stream;
+}
+
 OutputDataStream & operator<< (OutputDataStream & stream, uint64_t val) {
     stream.write((char*)&val, sizeof(uint64));
     return stream;
@@ -92,6 +97,14 @@ void InputDataStream::Append (const char * buffer, size_t length) {
     write(buffer, length);
 }
 
+bool InputDataStream::Read (char * buffer, size_t length) {
+    if (Length() < length)
+        return false;
+
+    read(buffer, length);
+    return true;
+}
+
 size_t InputDataStream::Length () {
     return (size_t)(tellp() - tellg());
 }
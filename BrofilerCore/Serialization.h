@@ -38,6 +38,7 @@ public:
     friend OutputDataStream & operator<< (OutputDataStream & stream, char val);
     friend OutputDataStream & operator<< (OutputDataStream & stream, uint8_t val);
     friend OutputDataStream & operator<< (OutputDataStream & stream, int8_t val);
+    friend OutputDataStream & operator<< (OutputDataStream & stream, double val);
     friend OutputDataStream & operator<< (OutputDataStream & stream, const std::string & val);
     friend OutputDataStream & operator<< (OutputDataStream & stream, const std::wstring & val);
 };
@@ -79,6 +80,7 @@ public:
     InputDataStream ();
 
     void Append (const char * buffer, size_t length);
+    bool Read (char * buffer, size_t length);
     bool Skip (size_t length);
     size_t Length ();
 
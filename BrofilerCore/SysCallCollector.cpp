@@ -1,7 +1,8 @@
 #include "SysCallCollector.h"
 #include "Core.h"
 
-#include <unordered_set>
+#include <map>
+#include <utility>
 
 namespace Brofiler {
 
@@ -11,34 +12,75 @@ namespace Brofiler {
 //
 /////
 
-void SysCallCollector::Add(const SysCallDesc& desc) {
-    if (uint64 * storage = syscallPool.TryAdd(2)) {
-        storage[0] = desc.timestamp;
-        storage[1] = desc.id;
+void SysCallCollector::Add (SysCallBuffer & buffer, const SysCallDesc & desc) {
+    if (desc.type == SysCallDesc::ENTER) {
+        SysCallData & data = buffer.Add();
+        data.start = desc.timestamp;
+        data.finish = SysCallData::OPEN;
+        data.id = desc.id;
+    }
+    else if (SysCallData * data = buffer.Back()) {
+        // Exit without a matching enter (e.g. the call started before the capture) is dropped
+        if (data->finish == SysCallData::OPEN && data->start <= desc.timestamp) {
+            data->finish = desc.timestamp;
+        }
+    }
+}
 
+bool SysCallCollector::Serialize (OutputDataStream & stream, const std::vector<ThreadEntry *> & threads, const std::vector<EventTime> & frames) {
+    uint32_t threadCount = 0;
+    for (const ThreadEntry * entry : threads) {
+        threadCount += entry->storage.sysCallBuffer.IsEmpty() ? 0 : 1;
     }
-    else {
-        uint64 & item0 = syscallPool.Add();
-        uint64 & item1 = syscallPool.Add();
 
-        item0 = desc.timestamp;
-        item1 = desc.id;
+    stream << threadCount;
+
+    for (size_t i = 0; i < threads.size(); ++i) {
+        const SysCallBuffer & buffer = threads[i]->storage.sysCallBuffer;
+        if (buffer.IsEmpty())
+            continue;
+
+        stream << (int32_t)i << (uint32_t)buffer.Size();
+
+        buffer.ForEach([&](const SysCallData & data) {
+            stream << data.start << data.finish << data.id;
+        });
     }
-}
 
-void SysCallCollector::Clear () {
-    syscallPool.Clear(false);
-}
+    // Per frame: {ThreadIndex, Id} => {Count, Time}, calls without exit add to the count only
+    using StatKey = std::pair<int32_t, uint64_t>;
+    using Stat = std::pair<uint32_t, int64_t>;
+    std::vector<std::map<StatKey, Stat>> frameStats(frames.size());
+
+    for (size_t i = 0; i < threads.size(); ++i) {
+        size_t frameIndex = 0;
+
+        // Calls of a thread are recorded in order, so the frame cursor only moves forward
+        threads[i]->storage.sysCallBuffer.ForEach([&](const SysCallData & data) {
+            while (frameIndex < frames.size() && frames[frameIndex].finish <= data.start) {
+                ++frameIndex;
+            }
+
+            if (frameIndex == frames.size() || data.start < frames[frameIndex].start)
+                return;
+
+            Stat & stat = frameStats[frameIndex][StatKey((int32_t)i, data.id)];
+            stat.first += 1;
+            stat.second += data.finish != SysCallData::OPEN ? data.finish - data.start : 0;
+        });
+    }
+
+    stream << (uint32_t)frames.size();
 
-bool SysCallCollector::Serialize (OutputDataStream & stream) {
-    stream << syscallPool;
+    for (size_t f = 0; f < frames.size(); ++f) {
+        stream << frames[f] << (uint32_t)frameStats[f].size();
 
-    if (!syscallPool.IsEmpty()) {
-        syscallPool.Clear(false);
-        return true;
+        for (auto it = frameStats[f].begin(); it != frameStats[f].end(); ++it) {
+            stream << it->first.first << it->first.second << it->second.first << it->second.second;
+        }
     }
 
-    return false;
+    return threadCount > 0;
 }
 
 } // Brofiler
@@ -5,8 +5,13 @@
 #include "MemoryPool.h"
 #include "Serialization.h"
 
+#include <vector>
+
 namespace Brofiler {
 
+struct ThreadEntry;
+
+
 ////////////////////////////////////////////////////////////
 //
 //    SysCallDesc
@@ -14,10 +19,33 @@ namespace Brofiler {
 /////
 
 struct SysCallDesc {
+    enum Type : uint8_t {
+        ENTER = 0,
+        EXIT  = 1,
+    };
+
     int64_t  timestamp;
+    uint64_t id;       // Not required for EXIT: it is paired with the last ENTER of the thread
+    uint64_t threadId; // System thread id
+    Type     type;
+};
+
+
+////////////////////////////////////////////////////////////
+//
+//    SysCallData
+//
+/////
+
+struct SysCallData : public EventTime {
     uint64_t id;
+
+    // finish of a call which hasn't returned yet (or whose exit was lost)
+    static const int64_t OPEN = 0;
 };
 
+using SysCallBuffer = MemoryPool<SysCallData, 256>;
+
 
 ////////////////////////////////////////////////////////////
 //
@@ -25,15 +53,15 @@ struct SysCallDesc {
 //
 /////
 
+// Calls are recorded into the buffer of the calling thread (EventStorage::sysCallBuffer) by the scheduler trace,
+// the collector pairs enter/exit events and aggregates per frame statistics when the capture is dumped.
 class SysCallCollector {
-    // Packed syscall events: {timestamp, id}
-    typedef MemoryPool<uint64, 1024 * 32> SysCallPool;
-    SysCallPool syscallPool;
 public:
-    void Add (const SysCallDesc & desc);
-    void Clear ();
+    void Add (SysCallBuffer & buffer, const SysCallDesc & desc);
 
-    bool Serialize (OutputDataStream & stream);
+    // Packet: {ThreadCount, {ThreadIndex, CallCount, {Start, Finish (0 - unknown), Id}[]}[],
+    //          FrameCount, {Start, Finish, StatCount, {ThreadIndex, Id, Count, Time}[]}[]}
+    bool Serialize (OutputDataStream & stream, const std::vector<ThreadEntry *> & threads, const std::vector<EventTime> & frames);
 };
 
 } // Brofiler
@@ -0,0 +1,366 @@
+#include "ThreadRegistry.h"
+#include "Core.h"
+
+namespace Brofiler {
+
+////////////////////////////////////////////////////////////
+//
+//    Helpers
+//
+/////
+
+namespace {
+
+// Uninitialized MT::ThreadId reports -1
+bool IsValidThreadId (uint64_t threadId) {
+    return threadId != 0 && threadId != (uint64_t)-1;
+}
+
+uint32_t GetIdPosition (uint64_t threadId, uint32_t size) {
+    // Windows thread ids are multiples of 4, pthread_t values are aligned pointers: spread them with a multiplicative hash
+    return (uint32_t)((threadId * 0x9E3779B97F4A7C15ull) >> 32) & (size - 1);
+}
+
+// FNV-1a, 0 is reserved for empty spares
+uint64_t GetNameHash (const char * name) {
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (const char * it = name; *it != 0; ++it)
+        hash = (hash ^ (uint8_t)*it) * 0x100000001B3ull;
+
+    return hash != 0 ? hash : 1;
+}
+
+bool IsAliveGeneration (uint32_t generation) {
+    return (generation & 1) != 0;
+}
+
+void DestroyEntry (ThreadEntry * entry) {
+    entry->~ThreadEntry();
+    MT::Memory::Free(entry);
+}
+
+} // namespace
+
+
+////////////////////////////////////////////////////////////
+//
+//    ThreadRegistry
+//
+/////
+
+ThreadRegistry::ThreadRegistry () {
+    for (std::atomic<Slot *> & chunk : chunks)
+        chunk.store(nullptr, std::memory_order_relaxed);
+
+    for (IdEntry & id : ids) {
+        id.id.store(0, std::memory_order_relaxed);
+        id.value.store(0, std::memory_order_relaxed);
+    }
+
+    for (Spare & spare : spares) {
+        spare.entry.store(nullptr, std::memory_order_relaxed);
+        spare.nameHash.store(0, std::memory_order_relaxed);
+    }
+
+    slotCount.store(0);
+    isIdTableFull.store(false);
+    spareCursor = 0;
+}
+
+ThreadRegistry::~ThreadRegistry () {
+    const uint32_t count = slotCount.load();
+    for (uint32_t i = 0; i < count; ++i) {
+        if (ThreadEntry * entry = GetSlot(i).entry.exchange(nullptr))
+            DestroyEntry(entry);
+    }
+
+    for (std::atomic<Slot *> & chunk : chunks) {
+        if (Slot * slots = chunk.exchange(nullptr))
+            MT::Memory::Free(slots);
+    }
+
+    for (Spare & spare : spares) {
+        if (ThreadEntry * entry = spare.entry.exchange(nullptr))
+            DestroyEntry(entry);
+    }
+}
+
+ThreadEntry * ThreadRegistry::Add (const ThreadDescription & description, EventStorage ** tls) {
+    ThreadEntry * entry = TakeSpare(description.name);
+
+    if (entry != nullptr)
+        entry->Reset(description, tls);
+    else
+        entry = new (MT::Memory::Alloc(sizeof(ThreadEntry), BRO_CACHE_LINE_SIZE)) ThreadEntry(description, tls);
+
+    uint32_t index = ClaimSlot(entry);
+    if (index == INVALID_SLOT) {
+        DestroyEntry(entry);
+        return nullptr;
+    }
+
+    const uint64_t threadId = description.threadID.AsUInt64();
+
+    Slot & slot = GetSlot(index);
+    slot.threadId.store(threadId);
+    uint32_t generation = slot.generation.fetch_add(1) + 1;
+
+    MapId(threadId, index, generation);
+    return entry;
+}
+
+bool ThreadRegistry::Remove (uint64_t threadId) {
+    uint32_t index = FindSlot(threadId);
+    if (index == INVALID_SLOT)
+        return false;
+
+    Slot & slot = GetSlot(index);
+    ThreadEntry * entry = slot.entry.load();
+
+    // Generation goes first: once the entry is dead Collect may release the slot for the next registration
+    slot.generation.fetch_add(1);
+    entry->isAlive = false;
+
+    UnmapId(threadId, index);
+    return true;
+}
+
+bool ThreadRegistry::Contains (uint64_t threadId) const {
+    return FindSlot(threadId) != INVALID_SLOT;
+}
+
+void ThreadRegistry::Snapshot (std::vector<ThreadEntry *> & threads) const {
+    threads.clear();
+
+    const uint32_t count = slotCount.load();
+    for (uint32_t i = 0; i < count; ++i) {
+        if (ThreadEntry * entry = GetSlot(i).entry.load())
+            threads.push_back(entry);
+    }
+}
+
+void ThreadRegistry::Collect () {
+    const uint32_t count = slotCount.load();
+    for (uint32_t i = 0; i < count; ++i) {
+        Slot & slot = GetSlot(i);
+        ThreadEntry * entry = slot.entry.load();
+
+        if (entry != nullptr && !entry->isAlive) {
+            slot.entry.store(nullptr);
+            PutSpare(entry);
+        }
+    }
+}
+
+ThreadEntry * ThreadRegistry::TakeSpare (const char * name) {
+    if (name == nullptr)
+        return nullptr;
+
+    const uint64_t nameHash = GetNameHash(name);
+
+    for (Spare & spare : spares) {
+        if (spare.nameHash.load() != nameHash)
+            continue;
+
+        // The spare may be replaced after the hash check (or the hash may collide), that only costs the chunks a better fit
+        ThreadEntry * entry = spare.entry.load();
+        if (entry != nullptr && spare.entry.compare_exchange_strong(entry, nullptr))
+            return entry;
+    }
+
+    return nullptr;
+}
+
+void ThreadRegistry::PutSpare (ThreadEntry * entry) {
+    // Entries without a name are reused by nobody
+    if (entry->description.name == nullptr) {
+        DestroyEntry(entry);
+        return;
+    }
+
+    const uint64_t nameHash = GetNameHash(entry->name);
+
+    for (Spare & spare : spares) {
+        // Only Collect fills the spares: an empty one stays empty until this store
+        if (spare.entry.load() == nullptr) {
+            spare.nameHash.store(nameHash);
+            spare.entry.store(entry);
+            return;
+        }
+    }
+
+    Spare & spare = spares[spareCursor++ % MAX_SPARE_COUNT];
+    spare.nameHash.store(nameHash);
+
+    if (ThreadEntry * evicted = spare.entry.exchange(entry))
+        DestroyEntry(evicted);
+}
+
+ThreadRegistry::Slot & ThreadRegistry::GetSlot (uint32_t index) const {
+    return chunks[index / SLOT_CHUNK_SIZE].load()[index % SLOT_CHUNK_SIZE];
+}
+
+ThreadRegistry::Slot * ThreadRegistry::GetChunk (uint32_t chunkIndex) {
+    Slot * chunk = chunks[chunkIndex].load();
+    if (chunk != nullptr)
+        return chunk;
+
+    Slot * slots = (Slot *)MT::Memory::Alloc(sizeof(Slot) * SLOT_CHUNK_SIZE, BRO_CACHE_LINE_SIZE);
+    for (uint32_t i = 0; i < SLOT_CHUNK_SIZE; ++i) {
+        Slot * slot = new (&slots[i]) Slot();
+        slot->entry.store(nullptr, std::memory_order_relaxed);
+        slot->threadId.store(0, std::memory_order_relaxed);
+        slot->generation.store(0, std::memory_order_relaxed);
+    }
+
+    // Registrations racing for the same chunk: the loser frees its copy
+    if (chunks[chunkIndex].compare_exchange_strong(chunk, slots))
+        return slots;
+
+    MT::Memory::Free(slots);
+    return chunk;
+}
+
+uint32_t ThreadRegistry::ClaimSlot (ThreadEntry * entry) {
+    for (;;) {
+        uint32_t count = slotCount.load();
+
+        // Slots released by Collect first, the table grows only when there are none
+        for (uint32_t i = 0; i < count; ++i) {
+            ThreadEntry * expected = nullptr;
+            if (GetSlot(i).entry.compare_exchange_strong(expected, entry))
+                return i;
+        }
+
+        if (count == MAX_THREAD_COUNT)
+            return INVALID_SLOT;
+
+        // The chunk is published before the counter moves past its first slot
+        const uint32_t index = count;
+        Slot * chunk = GetChunk(index / SLOT_CHUNK_SIZE);
+
+        ThreadEntry * expected = nullptr;
+        bool isClaimed = chunk[index % SLOT_CHUNK_SIZE].entry.compare_exchange_strong(expected, entry);
+
+        // Whoever claimed the slot, the counter has to move past it (a failed exchange overwrites count)
+        slotCount.compare_exchange_strong(count, index + 1);
+
+        if (isClaimed)
+            return index;
+    }
+}
+
+uint32_t ThreadRegistry::FindSlot (uint64_t threadId) const {
+    if (!IsValidThreadId(threadId))
+        return INVALID_SLOT;
+
+    uint32_t position = GetIdPosition(threadId, ID_TABLE_SIZE);
+
+    for (uint32_t probe = 0; probe < ID_TABLE_SIZE; ++probe, position = (position + 1) & (ID_TABLE_SIZE - 1)) {
+        uint64_t key = ids[position].id.load();
+        if (key == 0)
+            break;
+
+        // Tombstones and other ids
+        if (key != threadId)
+            continue;
+
+        uint64_t value = ids[position].value.load();
+        uint32_t index = (uint32_t)value;
+        uint32_t generation = (uint32_t)(value >> 32);
+
+        // The cell may have been reused by another id between the loads: the slot has to agree on both
+        if (!IsAliveGeneration(generation))
+            continue;
+
+        const Slot & slot = GetSlot(index);
+        if (slot.generation.load() == generation && slot.threadId.load() == threadId)
+            return index;
+    }
+
+    if (!isIdTableFull.load())
+        return INVALID_SLOT;
+
+    const uint32_t count = slotCount.load();
+    for (uint32_t i = 0; i < count; ++i) {
+        const Slot & slot = GetSlot(i);
+        if (slot.threadId.load() == threadId && IsAliveGeneration(slot.generation.load()))
+            return i;
+    }
+
+    return INVALID_SLOT;
+}
+
+void ThreadRegistry::MapId (uint64_t threadId, uint32_t index, uint32_t generation) {
+    if (!IsValidThreadId(threadId))
+        return;
+
+    const uint64_t value = ((uint64_t)generation << 32) | index;
+
+    for (;;) {
+        // The whole chain is checked for the id before a tombstone is taken, so an id is never mapped twice
+        IdEntry * target = nullptr;
+        IdEntry * freeEntry = nullptr;
+
+        uint32_t position = GetIdPosition(threadId, ID_TABLE_SIZE);
+
+        for (uint32_t probe = 0; probe < ID_TABLE_SIZE; ++probe, position = (position + 1) & (ID_TABLE_SIZE - 1)) {
+            uint64_t key = ids[position].id.load();
+
+            if (key == threadId) {
+                target = &ids[position];
+                break;
+            }
+
+            if (key == TOMBSTONE_ID && freeEntry == nullptr)
+                freeEntry = &ids[position];
+
+            if (key == 0) {
+                if (freeEntry == nullptr)
+                    freeEntry = &ids[position];
+                break;
+            }
+        }
+
+        if (target == nullptr) {
+            if (freeEntry == nullptr) {
+                isIdTableFull.store(true);
+                return;
+            }
+
+            uint64_t key = freeEntry->id.load();
+            if ((key != 0 && key != TOMBSTONE_ID) || !freeEntry->id.compare_exchange_strong(key, threadId))
+                continue; // Taken by another registration
+
+            target = freeEntry;
+        }
+
+        target->value.store(value);
+
+        // UnmapId of the previous thread with this id may have buried the cell before the value landed
+        if (target->id.load() == threadId)
+            return;
+    }
+}
+
+void ThreadRegistry::UnmapId (uint64_t threadId, uint32_t index) {
+    if (!IsValidThreadId(threadId))
+        return;
+
+    uint32_t position = GetIdPosition(threadId, ID_TABLE_SIZE);
+
+    for (uint32_t probe = 0; probe < ID_TABLE_SIZE; ++probe, position = (position + 1) & (ID_TABLE_SIZE - 1)) {
+        uint64_t key = ids[position].id.load();
+        if (key == 0)
+            return;
+
+        if (key != threadId || (uint32_t)ids[position].value.load() != index)
+            continue;
+
+        // Fails if the cell was taken meanwhile, then it isn't ours to bury
+        ids[position].id.compare_exchange_strong(key, TOMBSTONE_ID);
+        return;
+    }
+}
+
+} // Brofiler
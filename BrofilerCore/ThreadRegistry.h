@@ -0,0 +1,100 @@
+#pragma once
+#include <MTTypes.h>
+
+#include "Brofiler.h"
+
+#include <atomic>
+#include <vector>
+
+namespace Brofiler {
+
+struct ThreadEntry;
+struct ThreadDescription;
+
+
+////////////////////////////////////////////////////////////
+//
+//    ThreadRegistry
+//
+/////
+
+// Registered threads, shared by the registering threads and the dump without Core::lock.
+// Entries live in slots which never move: slots are allocated in chunks on demand, a slot is appended (or reused once
+// Collect released it) and published with a generation counter, odd - the thread is registered, even - the slot is empty or unregistered.
+// Add, Remove and Contains are lock-free. Snapshot and Collect must not run concurrently (both run under Core::lock).
+// Entries of dead threads are kept as spares and reused with their chunks by the next thread with the same name.
+class ThreadRegistry {
+public:
+    enum : uint32_t {
+        SLOT_CHUNK_SIZE  = 256,
+        MAX_CHUNK_COUNT  = 256,
+        MAX_THREAD_COUNT = SLOT_CHUNK_SIZE * MAX_CHUNK_COUNT, // Threads registered at once, dead ones count until Collect
+        MAX_SPARE_COUNT  = 32,   // An entry with the first chunks of all pools takes ~120KB
+        INVALID_SLOT     = 0xFFFFFFFF,
+    };
+
+    ThreadRegistry ();
+    ~ThreadRegistry ();
+
+    // Returns nullptr if all slots are taken
+    ThreadEntry * Add (const ThreadDescription & description, EventStorage ** tls);
+
+    // Called by the thread itself: marks its entry as dead, the memory is released by Collect
+    bool Remove (uint64_t threadId);
+
+    // O(1): a probe of the id table and a check of the slot generation
+    bool Contains (uint64_t threadId) const;
+
+    // All entries which are not collected yet (alive and dead) in slot order
+    void Snapshot (std::vector<ThreadEntry *> & threads) const;
+
+    // Releases the slots of the dead entries and keeps the entries as spares
+    void Collect ();
+
+private:
+    // MT atomics are 32-bit only, the id table needs 64-bit keys
+    struct Slot {
+        std::atomic<ThreadEntry *> entry;
+        std::atomic<uint64_t>      threadId;
+        std::atomic<uint32_t>      generation;
+    };
+
+    // Thread id => {Generation, SlotIndex}. Remove turns the id of the thread into a tombstone, which the next
+    // registration may take. Stale values fail the generation and the thread id checks of the slot.
+    struct IdEntry {
+        std::atomic<uint64_t> id; // 0 - empty, TOMBSTONE_ID - removed
+        std::atomic<uint64_t> value;
+    };
+
+    enum : uint32_t { ID_TABLE_SIZE = 4096 };
+    static constexpr uint64_t TOMBSTONE_ID = (uint64_t)-1; // Not a valid thread id
+
+    std::atomic<Slot *>   chunks[MAX_CHUNK_COUNT];
+    std::atomic<uint32_t> slotCount; // Slots below the count have their chunks allocated
+
+    IdEntry           ids[ID_TABLE_SIZE];
+    std::atomic<bool> isIdTableFull; // Lookups of unmapped ids fall back to a scan of the slots
+
+    // Filled by Collect only, emptied by the registrations which take the entry.
+    // The name is matched by hash: a spare entry may be evicted and freed by Collect at any moment, so nothing of it is read before it is taken.
+    struct Spare {
+        std::atomic<ThreadEntry *> entry;
+        std::atomic<uint64_t>      nameHash;
+    };
+
+    Spare    spares[MAX_SPARE_COUNT];
+    uint32_t spareCursor; // Next spare to evict when all of them are taken
+
+    ThreadEntry * TakeSpare (const char * name);
+    void PutSpare (ThreadEntry * entry);
+
+    Slot & GetSlot (uint32_t index) const;
+    Slot * GetChunk (uint32_t chunkIndex);
+
+    uint32_t ClaimSlot (ThreadEntry * entry);
+    uint32_t FindSlot (uint64_t threadId) const;
+    void MapId (uint64_t threadId, uint32_t index, uint32_t generation);
+    void UnmapId (uint64_t threadId, uint32_t index);
+};
+
+} // Brofiler
@@ -0,0 +1,237 @@
+#include "WaitChainCollector.h"
+#include "Core.h"
+
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <tuple>
+#include <unordered_map>
+
+namespace Brofiler {
+
+////////////////////////////////////////////////////////////
+//
+//    Helpers
+//
+/////
+
+namespace {
+
+enum SegmentType : uint8_t {
+    SEGMENT_RUN   = 0, // Thread was running
+    SEGMENT_WAIT  = 1, // Thread was blocked and nobody of ours woke it up
+    SEGMENT_READY = 2, // Thread was woken up, but didn't get a core yet
+};
+
+// A critical path of a frame is bounded, broken or cyclic data must not hang the dump
+const size_t MAX_SEGMENTS_PER_FRAME = 4096;
+
+const int32_t OTHER_THREAD = -1;
+
+struct RunInterval {
+    int64_t start;
+    int64_t finish;
+    uint8_t reason; // Why the thread switched out at finish
+};
+
+struct ThreadTimeline {
+    std::vector<RunInterval> intervals;
+    std::vector<WakeupData>  wakeups; // Sorted by timestamp
+};
+
+struct Segment {
+    int64_t     start;
+    int64_t     finish;
+    int32_t     threadIndex;
+    SegmentType type;
+};
+
+using EdgeKey = std::tuple<int32_t, int32_t, uint8_t>; // {Waiter, Waker, Reason}
+
+struct EdgeStats {
+    uint32_t count        = 0;
+    int64_t  waitTime     = 0;
+    int64_t  criticalTime = 0;
+};
+
+// Last wakeup inside of [start, finish]
+const WakeupData * FindWakeup (const ThreadTimeline & timeline, int64_t start, int64_t finish) {
+    auto it = std::upper_bound(timeline.wakeups.begin(), timeline.wakeups.end(), finish, [](int64_t time, const WakeupData & data) {
+        return time < data.timestamp;
+    });
+
+    if (it == timeline.wakeups.begin())
+        return nullptr;
+
+    --it;
+    return it->timestamp >= start ? &*it : nullptr;
+}
+
+// Index of the last interval which starts before time, -1 if none
+int FindInterval (const ThreadTimeline & timeline, int64_t time) {
+    auto it = std::lower_bound(timeline.intervals.begin(), timeline.intervals.end(), time, [](const RunInterval & interval, int64_t value) {
+        return interval.start < value;
+    });
+
+    return (int)(it - timeline.intervals.begin()) - 1;
+}
+
+} // namespace
+
+
+////////////////////////////////////////////////////////////
+//
+//    WaitChainCollector
+//
+/////
+
+void WaitChainCollector::Add (const WakeupDesc & desc) {
+    WakeupData & data = wakeupBuffer.Add();
+    data.timestamp = desc.timestamp;
+    data.wokenThreadId = desc.wokenThreadId;
+    data.wakerThreadId = desc.wakerThreadId;
+}
+
+void WaitChainCollector::Clear () {
+    wakeupBuffer.Clear(false);
+}
+
+void WaitChainCollector::Serialize (OutputDataStream & stream, const std::vector<ThreadEntry *> & threads, const std::vector<EventTime> & frames, uint32_t mainThreadIndex) {
+    const int64_t captureFinish = frames.empty() ? std::numeric_limits<int64_t>::max() : frames.back().finish;
+
+    std::unordered_map<uint64_t, int32_t> threadIndices;
+    std::vector<ThreadTimeline> timelines(threads.size());
+
+    for (size_t i = 0; i < threads.size(); ++i) {
+        threadIndices[threads[i]->description.systemThreadId] = (int32_t)i;
+
+        std::vector<RunInterval> & intervals = timelines[i].intervals;
+        threads[i]->storage.synchronizationBuffer.ForEach([&](const SyncData & data) {
+            RunInterval interval = { data.start, data.finish, (uint8_t)data.reason };
+            intervals.push_back(interval);
+        });
+
+        // The thread was still running when the trace stopped
+        if (!intervals.empty() && intervals.back().finish == intervals.back().start) {
+            intervals.back().finish = captureFinish;
+        }
+    }
+
+    wakeupBuffer.ForEach([&](const WakeupData & data) {
+        auto it = threadIndices.find(data.wokenThreadId);
+        if (it != threadIndices.end()) {
+            timelines[it->second].wakeups.push_back(data);
+        }
+    });
+
+    for (ThreadTimeline & timeline : timelines) {
+        std::sort(timeline.wakeups.begin(), timeline.wakeups.end(), [](const WakeupData & a, const WakeupData & b) {
+            return a.timestamp < b.timestamp;
+        });
+    }
+
+    auto getWakerIndex = [&](const WakeupData * wakeup) -> int32_t {
+        if (wakeup == nullptr)
+            return OTHER_THREAD;
+
+        auto it = threadIndices.find(wakeup->wakerThreadId);
+        return it != threadIndices.end() ? it->second : OTHER_THREAD;
+    };
+
+    // Every wait of every thread
+    std::map<EdgeKey, EdgeStats> edges;
+
+    for (size_t i = 0; i < timelines.size(); ++i) {
+        const ThreadTimeline & timeline = timelines[i];
+
+        for (size_t k = 0; k + 1 < timeline.intervals.size(); ++k) {
+            int64_t waitStart = timeline.intervals[k].finish;
+            int64_t waitFinish = timeline.intervals[k + 1].start;
+
+            int32_t waker = getWakerIndex(FindWakeup(timeline, waitStart, waitFinish));
+
+            EdgeStats & stats = edges[EdgeKey((int32_t)i, waker, timeline.intervals[k].reason)];
+            ++stats.count;
+            stats.waitTime += waitFinish - waitStart;
+        }
+    }
+
+    // Critical path of every frame: from the end of the frame on the main thread, backwards through the wakers
+    std::vector<std::vector<Segment>> paths(frames.size());
+
+    for (size_t f = 0; f < frames.size() && mainThreadIndex < timelines.size(); ++f) {
+        const EventTime & frame = frames[f];
+        std::vector<Segment> & path = paths[f];
+
+        int32_t threadIndex = (int32_t)mainThreadIndex;
+        int64_t time = frame.finish;
+
+        while (time > frame.start && path.size() < MAX_SEGMENTS_PER_FRAME) {
+            const ThreadTimeline & timeline = timelines[threadIndex];
+
+            int k = FindInterval(timeline, time);
+            if (k < 0)
+                break;
+
+            const RunInterval & interval = timeline.intervals[k];
+
+            if (interval.finish >= time) {
+                int64_t start = std::max(interval.start, frame.start);
+                Segment segment = { start, time, threadIndex, SEGMENT_RUN };
+                path.push_back(segment);
+
+                time = start;
+                continue;
+            }
+
+            // Blocked at this time: the wait started at the end of the interval
+            int64_t waitStart = interval.finish;
+            int64_t waitFinish = (size_t)(k + 1) < timeline.intervals.size() ? timeline.intervals[k + 1].start : captureFinish;
+
+            const WakeupData * wakeup = FindWakeup(timeline, waitStart, waitFinish);
+            int32_t waker = getWakerIndex(wakeup);
+
+            int64_t start = std::max(waitStart, frame.start);
+            EdgeStats & stats = edges[EdgeKey(threadIndex, waker, interval.reason)];
+
+            if (waker != OTHER_THREAD && wakeup->timestamp <= time && wakeup->timestamp > frame.start) {
+                // Only the ready time is on the path, the wait before the wakeup is walked on the waker's thread
+                stats.criticalTime += time - wakeup->timestamp;
+
+                Segment segment = { wakeup->timestamp, time, threadIndex, SEGMENT_READY };
+                path.push_back(segment);
+
+                // The waker was running when it released us
+                threadIndex = waker;
+                time = wakeup->timestamp;
+            }
+            else {
+                stats.criticalTime += time - start;
+
+                Segment segment = { start, time, threadIndex, SEGMENT_WAIT };
+                path.push_back(segment);
+
+                time = start;
+            }
+        }
+
+        std::reverse(path.begin(), path.end());
+    }
+
+    stream << (uint32_t)edges.size();
+    for (auto it = edges.begin(); it != edges.end(); ++it) {
+        stream << std::get<0>(it->first) << std::get<1>(it->first) << std::get<2>(it->first);
+        stream << it->second.count << it->second.waitTime << it->second.criticalTime;
+    }
+
+    stream << (uint32_t)frames.size();
+    for (size_t f = 0; f < frames.size(); ++f) {
+        stream << frames[f] << (uint32_t)paths[f].size();
+
+        for (const Segment & segment : paths[f]) {
+            stream << segment.start << segment.finish << segment.threadIndex << (uint8_t)segment.type;
+        }
+    }
+}
+
+} // Brofiler
@@ -0,0 +1,51 @@
+#pragma once
+#include <MTTypes.h>
+
+#include "Brofiler.h"
+#include "MemoryPool.h"
+#include "Serialization.h"
+
+#include <vector>
+
+namespace Brofiler {
+
+struct ThreadEntry;
+struct WakeupDesc;
+
+
+////////////////////////////////////////////////////////////
+//
+//    WakeupData
+//
+/////
+
+// One of our threads was made ready to run
+struct WakeupData {
+    int64_t  timestamp;
+    uint64_t wokenThreadId;
+    uint64_t wakerThreadId;
+};
+
+
+////////////////////////////////////////////////////////////
+//
+//    WaitChainCollector
+//
+/////
+
+// Links every wait of our threads (a gap between two SyncData intervals) to the thread which ended it
+// and walks the chains back from the end of each frame to find the critical path.
+// Fed by the scheduler trace thread only, read after the trace is stopped.
+class WaitChainCollector {
+    using WakeupBuffer = MemoryPool<WakeupData, 1024>;
+    WakeupBuffer wakeupBuffer;
+public:
+    void Add (const WakeupDesc & desc);
+    void Clear ();
+
+    // Packet: {EdgeCount, {WaiterThreadIndex, WakerThreadIndex (-1 - other process or unknown), Reason, Count, WaitTime, CriticalTime}[],
+    //          FrameCount, {Start, Finish, SegmentCount, {Start, Finish, ThreadIndex, Type}[]}[]}
+    void Serialize (OutputDataStream & stream, const std::vector<ThreadEntry *> & threads, const std::vector<EventTime> & frames, uint32_t mainThreadIndex);
+};
+
+} // Brofiler
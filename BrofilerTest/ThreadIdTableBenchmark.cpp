@@ -0,0 +1,112 @@
+#include "ThreadIdTableBenchmark.h"
+#include "Platform/ThreadIdTable.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+namespace Test {
+
+using Brofiler::ThreadEntry;
+using Brofiler::ThreadIdTable;
+
+////////////////////////////////////////////////////////////
+//
+//    Helpers
+//
+/////
+
+namespace {
+
+constexpr uint32_t LOOKUP_COUNT    = 4 * 1024 * 1024;
+constexpr uint32_t FOREIGN_PERCENT = 90;
+
+const uint32_t THREAD_COUNTS[] = { 8, 64, 256 };
+
+// Kernel thread ids of one process are handed out close to each other
+std::vector<uint64_t> MakeThreadIds (std::mt19937_64 & random, uint32_t count) {
+    std::vector<uint64_t> ids;
+    uint64_t id = 1000 + random() % 100000;
+
+    for (uint32_t i = 0; i < count; ++i) {
+        id += 1 + random() % 8;
+        ids.push_back(id);
+    }
+
+    return ids;
+}
+
+// Context switches on the machine: FOREIGN_PERCENT of them belong to threads which are not registered
+std::vector<uint64_t> MakeLookups (std::mt19937_64 & random, const std::vector<uint64_t> & threadIds) {
+    std::vector<uint64_t> lookups(LOOKUP_COUNT);
+
+    for (uint64_t & id : lookups) {
+        if (random() % 100 < FOREIGN_PERCENT)
+            id = 1 + random() % 4000000;
+        else
+            id = threadIds[random() % threadIds.size()];
+    }
+
+    return lookups;
+}
+
+// Nanoseconds per lookup, found entries are summed up so the loop can't be thrown away
+template<class Func>
+double Measure (const std::vector<uint64_t> & lookups, Func find, uintptr_t & checksum) {
+    auto start = std::chrono::high_resolution_clock::now();
+
+    for (uint64_t id : lookups)
+        checksum += (uintptr_t)find(id);
+
+    auto finish = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::nano>(finish - start).count() / lookups.size();
+}
+
+} // namespace
+
+
+////////////////////////////////////////////////////////////
+//
+//    ThreadIdTable Benchmark
+//
+/////
+
+void RunThreadIdTableBenchmark () {
+    std::mt19937_64 random(42);
+
+    printf("ThreadIdTable benchmark: %u lookups, %u%% foreign ids\n", LOOKUP_COUNT, FOREIGN_PERCENT);
+
+    for (uint32_t threadCount : THREAD_COUNTS) {
+        std::vector<uint64_t> threadIds = MakeThreadIds(random, threadCount);
+        std::vector<uint64_t> lookups = MakeLookups(random, threadIds);
+
+        // Only the pointer values matter, the entries are never dereferenced
+        std::unordered_map<uint64_t, ThreadEntry *> map;
+        ThreadIdTable table;
+
+        for (size_t i = 0; i < threadIds.size(); ++i) {
+            ThreadEntry * entry = (ThreadEntry *)(uintptr_t)(i + 1);
+            map[threadIds[i]] = entry;
+            table.Insert(threadIds[i], entry);
+        }
+
+        uintptr_t mapChecksum = 0;
+        double mapTime = Measure(lookups, [&map](uint64_t id) -> ThreadEntry * {
+            auto it = map.find(id);
+            return it != map.end() ? it->second : nullptr;
+        }, mapChecksum);
+
+        uintptr_t tableChecksum = 0;
+        double tableTime = Measure(lookups, [&table](uint64_t id) {
+            return table.Find(id);
+        }, tableChecksum);
+
+        printf("%4u threads: unordered_map %5.1f ns, ThreadIdTable %5.1f ns%s\n", threadCount, mapTime, tableTime,
+               mapChecksum == tableChecksum ? "" : " (MISMATCH)");
+    }
+}
+
+} // Test
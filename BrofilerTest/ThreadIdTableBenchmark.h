@@ -0,0 +1,15 @@
+#pragma once
+
+namespace Test {
+
+////////////////////////////////////////////////////////////
+//
+//    ThreadIdTable Benchmark
+//
+/////
+
+// Compares ThreadIdTable with std::unordered_map on the ReportSwitchContext pattern: most of the looked up ids
+// belong to other processes. Prints the average lookup time for 8, 64 and 256 registered threads.
+void RunThreadIdTableBenchmark ();
+
+} // Test
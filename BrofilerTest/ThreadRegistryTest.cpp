@@ -0,0 +1,192 @@
+#include "ThreadRegistryTest.h"
+#include "Core.h"
+#include "ThreadRegistry.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace Test {
+
+using Brofiler::ThreadDescription;
+using Brofiler::ThreadEntry;
+using Brofiler::ThreadRegistry;
+
+////////////////////////////////////////////////////////////
+//
+//    Helpers
+//
+/////
+
+namespace {
+
+constexpr uint32_t WORKER_COUNT      = 8;
+constexpr uint32_t ITERATION_COUNT   = 5000;
+constexpr uint32_t LIVE_THREAD_COUNT = ThreadRegistry::SLOT_CHUNK_SIZE * 4 + 100;
+constexpr uint32_t ROUND_COUNT       = 20;
+constexpr uint32_t THREADS_PER_ROUND = 256;
+
+const char * const THREAD_NAMES[] = { "Worker", "IO", "Render" };
+
+std::atomic<uint32_t> g_failureCount;
+
+void Check (bool condition, const char * message) {
+    if (!condition && g_failureCount.fetch_add(1) == 0)
+        printf("ThreadRegistry stress test failed: %s\n", message);
+}
+
+uint64_t GetThreadId () {
+    return MT::ThreadId::Self().AsUInt64();
+}
+
+ThreadEntry * RegisterSelf (ThreadRegistry & registry, const char * name) {
+    // Heap copy: the registry must not keep the caller's string
+    char * nameCopy = strdup(name);
+
+    ThreadDescription description(nameCopy, MT::ThreadId::Self(), ThreadDescription::GetCurrentSystemThreadId(), false);
+    ThreadEntry * entry = registry.Add(description, nullptr);
+
+    free(nameCopy);
+    return entry;
+}
+
+void WaitFor (const std::atomic<uint32_t> & counter, uint32_t value) {
+    while (counter.load() < value)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+void ChurnRegistrations (ThreadRegistry & registry, uint32_t worker) {
+    const uint64_t threadId = GetThreadId();
+
+    for (uint32_t i = 0; i < ITERATION_COUNT; ++i) {
+        ThreadEntry * entry = RegisterSelf(registry, THREAD_NAMES[(worker + i) % 3]);
+        Check(entry != nullptr, "registration failed");
+        if (entry == nullptr)
+            continue;
+
+        Check(entry->description.threadID.AsUInt64() == threadId, "wrong entry");
+        Check(registry.Contains(threadId), "registered thread is not found");
+        Check(registry.Remove(threadId), "registered thread can't be removed");
+        Check(!registry.Contains(threadId), "removed thread is still found");
+    }
+}
+
+void CollectEntries (ThreadRegistry & registry, const std::atomic<bool> & isRunning) {
+    std::vector<ThreadEntry *> threads;
+
+    while (isRunning.load()) {
+        registry.Collect();
+        registry.Snapshot(threads);
+
+        // Dead entries are dumped with their names long after the threads are gone
+        for (ThreadEntry * entry : threads) {
+            volatile size_t length = strlen(entry->description.name);
+            (void)length;
+        }
+    }
+}
+
+void RunConcurrentChurn () {
+    ThreadRegistry * registry = new ThreadRegistry();
+    std::atomic<bool> isRunning(true);
+
+    std::thread collector(CollectEntries, std::ref(*registry), std::cref(isRunning));
+
+    std::vector<std::thread> workers;
+    for (uint32_t worker = 0; worker < WORKER_COUNT; ++worker)
+        workers.emplace_back(ChurnRegistrations, std::ref(*registry), worker);
+
+    for (std::thread & worker : workers)
+        worker.join();
+
+    isRunning.store(false);
+    collector.join();
+
+    delete registry;
+}
+
+// A capture never collects: every thread registered during it keeps its slot
+void RunLiveThreadOverflow () {
+    ThreadRegistry * registry = new ThreadRegistry();
+    std::atomic<uint32_t> registeredCount(0);
+    std::atomic<uint32_t> checkedCount(0);
+
+    std::vector<std::thread> threads;
+    for (uint32_t i = 0; i < LIVE_THREAD_COUNT; ++i) {
+        threads.emplace_back([&] {
+            Check(RegisterSelf(*registry, "Worker") != nullptr, "registration beyond the first chunks failed");
+
+            registeredCount.fetch_add(1);
+            WaitFor(registeredCount, LIVE_THREAD_COUNT);
+
+            Check(registry->Contains(GetThreadId()), "live thread is not found");
+
+            // Thread ids may be reused once the threads exit
+            checkedCount.fetch_add(1);
+            WaitFor(checkedCount, LIVE_THREAD_COUNT);
+
+            Check(registry->Remove(GetThreadId()), "registered thread can't be removed");
+        });
+    }
+
+    for (std::thread & thread : threads)
+        thread.join();
+
+    delete registry;
+}
+
+// Every removed id leaves a tombstone, the next registrations have to reuse them
+void RunThreadTurnover () {
+    ThreadRegistry * registry = new ThreadRegistry();
+
+    for (uint32_t round = 0; round < ROUND_COUNT; ++round) {
+        std::vector<std::thread> threads;
+        for (uint32_t i = 0; i < THREADS_PER_ROUND; ++i) {
+            threads.emplace_back([&] {
+                const uint64_t threadId = GetThreadId();
+
+                Check(RegisterSelf(*registry, THREAD_NAMES[round % 3]) != nullptr, "registration failed");
+                Check(registry->Contains(threadId), "registered thread is not found");
+                Check(registry->Remove(threadId), "registered thread can't be removed");
+                Check(!registry->Contains(threadId), "removed thread is still found");
+            });
+        }
+
+        for (std::thread & thread : threads)
+            thread.join();
+
+        registry->Collect();
+    }
+
+    std::vector<ThreadEntry *> threads;
+    registry->Snapshot(threads);
+    Check(threads.empty(), "collected entries are still listed");
+
+    delete registry;
+}
+
+} // namespace
+
+
+////////////////////////////////////////////////////////////
+//
+//    ThreadRegistry Stress Test
+//
+/////
+
+bool RunThreadRegistryStressTest () {
+    g_failureCount.store(0);
+
+    RunConcurrentChurn();
+    RunLiveThreadOverflow();
+    RunThreadTurnover();
+
+    return g_failureCount.load() == 0;
+}
+
+} // Test
@@ -0,0 +1,16 @@
+#pragma once
+
+namespace Test {
+
+////////////////////////////////////////////////////////////
+//
+//    ThreadRegistry Stress Test
+//
+/////
+
+// Registers, looks up and removes threads from many threads at once while a collector recycles the entries.
+// Also checks more live threads than the first slot chunks and a turnover of short-lived threads.
+// Meant to be built with -fsanitize=thread (or address), returns false if any check failed.
+bool RunThreadRegistryStressTest ();
+
+} // Test
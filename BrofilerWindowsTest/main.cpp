@@ -1,6 +1,8 @@
 #include <iostream>
 #include "Brofiler.h"
 #include "TestEngine.h"
+#include "ThreadIdTableBenchmark.h"
+#include "ThreadRegistryTest.h"
 
 #if MT_MSVC_COMPILER_FAMILY
 #pragma warning( push )
@@ -15,12 +17,41 @@
 
 using namespace std;
 
+template<class Char>
+static bool IsSwitch(const Char* arg, const char* name)
+{
+	while (*name != 0 && (Char)*name == *arg)
+	{
+		++name;
+		++arg;
+	}
+
+	return *name == 0 && *arg == 0;
+}
+
 #if MT_PLATFORM_WINDOWS
-int wmain()
+int wmain(int argc, wchar_t* argv[])
 #else
-int main()
+int main(int argc, char* argv[])
 #endif
 {
+	// Standalone tests of the core run instead of the profiled main loop
+	for (int i = 1; i < argc; ++i)
+	{
+		if (IsSwitch(argv[i], "--thread-id-benchmark"))
+		{
+			Test::RunThreadIdTableBenchmark();
+			return 0;
+		}
+
+		if (IsSwitch(argv[i], "--thread-registry-test"))
+		{
+			bool passed = Test::RunThreadRegistryStressTest();
+			cout << "ThreadRegistry stress test " << (passed ? "passed" : "FAILED") << endl;
+			return passed ? 0 : 1;
+		}
+	}
+
 	cout << "Starting profiler test." << endl;
 
 	Test::Engine engine;